@@ -18,6 +18,7 @@ typedef enum _GR_DBG_DATA_TYPE
     GR_DBG_DATA_MEMORY_OBJECT_LAYOUT = 0x00020c00,
     GR_DBG_DATA_MEMORY_OBJECT_STATE = 0x00020c01,
     GR_DBG_DATA_SEMAPHORE_IS_BLOCKED = 0x00020d00,
+    GR_DBG_DATA_GRVK_QUEUE_STATS = 0x00021000, // GRVK extension
 } GR_DBG_DATA_TYPE;
 
 typedef enum _GR_DBG_DEVICE_OPTION
@@ -33,6 +34,7 @@ typedef enum _GR_DBG_GLOBAL_OPTION
     GR_DBG_OPTION_DEBUG_ECHO_ENABLE = 0x00020100,
     GR_DBG_OPTION_BREAK_ON_ERROR = 0x00020101,
     GR_DBG_OPTION_BREAK_ON_WARNING = 0x00020102,
+    GR_DBG_OPTION_GRVK_STATS_DUMP_INTERVAL = 0x00021100, // GRVK extension
 } GR_DBG_GLOBAL_OPTION;
 
 typedef enum _GR_DBG_MSG_FILTER
@@ -94,6 +96,31 @@ typedef GR_VOID (GR_STDCALL *GR_DBG_MSG_CALLBACK_FUNCTION)(
     const GR_CHAR* pMsg,
     GR_VOID* pUserData);
 
+// Data Structures
+
+// Work submitted to a queue since its creation. Render pass and framebuffer counts are shared by
+// all queues of the device.
+typedef struct _GR_DBG_GRVK_QUEUE_STATS
+{
+    GR_UINT64 submitCount;
+    GR_UINT64 cmdBufferCount;
+    GR_UINT64 drawCallCount;
+    GR_UINT64 dispatchCallCount;
+    GR_UINT64 bindCallCount;
+    GR_UINT64 skippedBindCount;
+    GR_UINT64 dynamicStateCallCount;
+    GR_UINT64 skippedDynamicStateCallCount;
+    GR_UINT64 barrierCallCount;
+    GR_UINT64 renderPassBeginCount;
+    GR_UINT64 mergedIndirectCallCount;
+    GR_UINT64 mergedIndirectDrawCount;
+    GR_UINT64 mergedTransferCount;
+    GR_UINT64 renderPassCreateCount;
+    GR_UINT64 renderPassCacheHitCount;
+    GR_UINT64 framebufferCreateCount;
+    GR_UINT64 framebufferCacheHitCount;
+} GR_DBG_GRVK_QUEUE_STATS;
+
 // Functions
 
 GR_RESULT GR_STDCALL grDbgSetValidationLevel(
@@ -0,0 +1,94 @@
+#include "mantle_internal.h"
+
+#define ARENA_ALIGNMENT 8
+
+typedef struct _ArenaChunk {
+    struct _ArenaChunk* next;
+    size_t size;
+    size_t offset;
+    _Alignas(ARENA_ALIGNMENT) uint8_t data[];
+} ArenaChunk;
+
+// Bump-pointer allocator, chunks are kept across resets so a warmed-up arena doesn't hit the heap
+struct _Arena {
+    ArenaChunk* firstChunk;
+    ArenaChunk* currentChunk;
+    size_t chunkSize;
+};
+
+static ArenaChunk* createArenaChunk(
+    size_t size)
+{
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+    *chunk = (ArenaChunk) {
+        .next = NULL,
+        .size = size,
+        .offset = 0,
+    };
+
+    return chunk;
+}
+
+Arena* createArena(
+    size_t chunkSize)
+{
+    Arena* arena = malloc(sizeof(Arena));
+    ArenaChunk* chunk = createArenaChunk(chunkSize);
+
+    *arena = (Arena) {
+        .firstChunk = chunk,
+        .currentChunk = chunk,
+        .chunkSize = chunkSize,
+    };
+
+    return arena;
+}
+
+void destroyArena(
+    Arena* arena)
+{
+    ArenaChunk* chunk = arena->firstChunk;
+
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
+
+void* allocArena(
+    Arena* arena,
+    size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaChunk* chunk = arena->currentChunk;
+    while (chunk->offset + size > chunk->size) {
+        if (chunk->next == NULL) {
+            chunk->next = createArenaChunk(MAX(arena->chunkSize, size));
+        } else if (chunk->next->size < size) {
+            // Insert a chunk large enough for this allocation
+            ArenaChunk* newChunk = createArenaChunk(size);
+            newChunk->next = chunk->next;
+            chunk->next = newChunk;
+        }
+
+        chunk = chunk->next;
+        chunk->offset = 0;
+    }
+
+    void* ptr = &chunk->data[chunk->offset];
+    chunk->offset += size;
+    arena->currentChunk = chunk;
+
+    return ptr;
+}
+
+void resetArena(
+    Arena* arena)
+{
+    arena->currentChunk = arena->firstChunk;
+    arena->currentChunk->offset = 0;
+}
@@ -0,0 +1,297 @@
+#include "mantle_internal.h"
+
+#define MAX_THREAD_CMD_POOLS 8
+
+// Vulkan command pools are externally synchronized, so every thread records into its own pools.
+// Released command buffers are kept on a free list for reuse, and the ones released from another
+// thread are queued and retired later by the owning thread.
+struct _CmdPool {
+    CmdPool* next;
+    const CmdPoolManager* manager;
+    uint32_t queueFamilyIndex;
+    DWORD threadId;
+    VkCommandPool commandPool;
+    uint32_t commandBufferCount;
+    VkCommandBuffer* freeCommandBuffers;
+    uint32_t freeCount;
+    uint32_t freeCapacity;
+    CRITICAL_SECTION pendingLock;
+    VkCommandBuffer* pendingReleases;
+    uint32_t pendingReleaseCount;
+    uint32_t pendingReleaseCapacity;
+};
+
+// Owns the pools of all threads, which outlive their thread until the device is destroyed
+struct _CmdPoolManager {
+    uint64_t id; // Never reused, unlike the address of a destroyed manager
+    VkDevice device;
+    CRITICAL_SECTION lock;
+    CmdPool* firstPool;
+};
+
+// Pools recently used by the calling thread. Entries are only matched by manager ID, so the ones
+// left behind by a destroyed manager are never dereferenced.
+typedef struct _ThreadCmdPool {
+    uint64_t managerId;
+    uint32_t queueFamilyIndex;
+    CmdPool* cmdPool;
+} ThreadCmdPool;
+
+static _Atomic uint64_t mNextCmdPoolManagerId = 1;
+static _Thread_local ThreadCmdPool mThreadCmdPools[MAX_THREAD_CMD_POOLS];
+static _Thread_local uint32_t mNextThreadCmdPool = 0;
+
+static CmdPool* createCmdPool(
+    CmdPoolManager* manager,
+    uint32_t queueFamilyIndex)
+{
+    VkCommandPool vkCommandPool = VK_NULL_HANDLE;
+
+    // Command buffers are reused across recordings and get reset implicitly when begun
+    const VkCommandPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamilyIndex,
+    };
+
+    if (vki.vkCreateCommandPool(manager->device, &poolCreateInfo, NULL,
+                                &vkCommandPool) != VK_SUCCESS) {
+        printf("%s: vkCreateCommandPool failed\n", __func__);
+        return NULL;
+    }
+
+    CmdPool* cmdPool = malloc(sizeof(CmdPool));
+    *cmdPool = (CmdPool) {
+        .next = NULL,
+        .manager = manager,
+        .queueFamilyIndex = queueFamilyIndex,
+        .threadId = GetCurrentThreadId(),
+        .commandPool = vkCommandPool,
+        .commandBufferCount = 0,
+        .freeCommandBuffers = NULL,
+        .freeCount = 0,
+        .freeCapacity = 0,
+        .pendingReleases = NULL,
+        .pendingReleaseCount = 0,
+        .pendingReleaseCapacity = 0,
+    };
+
+    InitializeCriticalSection(&cmdPool->pendingLock);
+
+    EnterCriticalSection(&manager->lock);
+    cmdPool->next = manager->firstPool;
+    manager->firstPool = cmdPool;
+    LeaveCriticalSection(&manager->lock);
+
+    return cmdPool;
+}
+
+static void destroyCmdPool(
+    CmdPool* cmdPool)
+{
+    // Command buffers are freed along with their pool
+    vki.vkDestroyCommandPool(cmdPool->manager->device, cmdPool->commandPool, NULL);
+    DeleteCriticalSection(&cmdPool->pendingLock);
+    free(cmdPool->freeCommandBuffers);
+    free(cmdPool->pendingReleases);
+    free(cmdPool);
+}
+
+// Looks up a pool created by a thread with the same ID, which has exited if it isn't the caller
+static CmdPool* findCmdPool(
+    CmdPoolManager* manager,
+    uint32_t queueFamilyIndex)
+{
+    DWORD threadId = GetCurrentThreadId();
+    CmdPool* cmdPool;
+
+    EnterCriticalSection(&manager->lock);
+    for (cmdPool = manager->firstPool; cmdPool != NULL; cmdPool = cmdPool->next) {
+        if (cmdPool->threadId == threadId && cmdPool->queueFamilyIndex == queueFamilyIndex) {
+            break;
+        }
+    }
+    LeaveCriticalSection(&manager->lock);
+
+    return cmdPool;
+}
+
+static void appendCommandBuffers(
+    VkCommandBuffer** pArray,
+    uint32_t* pCount,
+    uint32_t* pCapacity,
+    uint32_t commandBufferCount,
+    const VkCommandBuffer* pCommandBuffers)
+{
+    if (*pCount + commandBufferCount > *pCapacity) {
+        *pCapacity = MAX(*pCapacity == 0 ? 16 : *pCapacity * 2, *pCount + commandBufferCount);
+        *pArray = realloc(*pArray, sizeof(VkCommandBuffer) * *pCapacity);
+    }
+
+    memcpy(&(*pArray)[*pCount], pCommandBuffers, sizeof(VkCommandBuffer) * commandBufferCount);
+    *pCount += commandBufferCount;
+}
+
+// Must be called from the thread owning the pool
+static void retireCommandBuffers(
+    CmdPool* cmdPool,
+    uint32_t commandBufferCount,
+    const VkCommandBuffer* pCommandBuffers)
+{
+    appendCommandBuffers(&cmdPool->freeCommandBuffers, &cmdPool->freeCount,
+                         &cmdPool->freeCapacity, commandBufferCount, pCommandBuffers);
+
+    if (commandBufferCount > 0 && cmdPool->freeCount == cmdPool->commandBufferCount) {
+        // Every command buffer of the pool is retired, reset them all at once
+        if (vki.vkResetCommandPool(cmdPool->manager->device, cmdPool->commandPool,
+                                   0) != VK_SUCCESS) {
+            printf("%s: vkResetCommandPool failed\n", __func__);
+        }
+    }
+}
+
+// Must be called from the thread owning the pool
+static void retirePendingCommandBuffers(
+    CmdPool* cmdPool)
+{
+    EnterCriticalSection(&cmdPool->pendingLock);
+    retireCommandBuffers(cmdPool, cmdPool->pendingReleaseCount, cmdPool->pendingReleases);
+    cmdPool->pendingReleaseCount = 0;
+    LeaveCriticalSection(&cmdPool->pendingLock);
+}
+
+static VkCommandBuffer allocCmdPoolCommandBuffer(
+    CmdPool* cmdPool)
+{
+    VkCommandBuffer vkCommandBuffer = VK_NULL_HANDLE;
+
+    retirePendingCommandBuffers(cmdPool);
+
+    // Retired command buffers get reset implicitly when they begin recording again
+    if (cmdPool->freeCount > 0) {
+        cmdPool->freeCount--;
+        return cmdPool->freeCommandBuffers[cmdPool->freeCount];
+    }
+
+    const VkCommandBufferAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = cmdPool->commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    if (vki.vkAllocateCommandBuffers(cmdPool->manager->device, &allocateInfo,
+                                     &vkCommandBuffer) != VK_SUCCESS) {
+        printf("%s: vkAllocateCommandBuffers failed\n", __func__);
+        return VK_NULL_HANDLE;
+    }
+
+    cmdPool->commandBufferCount++;
+    return vkCommandBuffer;
+}
+
+CmdPoolManager* createCmdPoolManager(
+    VkDevice device)
+{
+    CmdPoolManager* manager = malloc(sizeof(CmdPoolManager));
+    *manager = (CmdPoolManager) {
+        .id = mNextCmdPoolManagerId++,
+        .device = device,
+        .firstPool = NULL,
+    };
+
+    InitializeCriticalSection(&manager->lock);
+
+    return manager;
+}
+
+// Destroys the pools of all threads, none of their command buffers may be in use anymore
+void destroyCmdPoolManager(
+    CmdPoolManager* manager)
+{
+    EnterCriticalSection(&manager->lock);
+    while (manager->firstPool != NULL) {
+        CmdPool* cmdPool = manager->firstPool;
+
+        manager->firstPool = cmdPool->next;
+        destroyCmdPool(cmdPool);
+    }
+    LeaveCriticalSection(&manager->lock);
+
+    DeleteCriticalSection(&manager->lock);
+    free(manager);
+}
+
+// Returns the calling thread's pool for the queue family, the lookup only takes the manager lock
+// when the pool isn't among the ones the thread used recently
+CmdPool* getThreadCmdPool(
+    CmdPoolManager* manager,
+    uint32_t queueFamilyIndex)
+{
+    for (int i = 0; i < MAX_THREAD_CMD_POOLS; i++) {
+        const ThreadCmdPool* threadCmdPool = &mThreadCmdPools[i];
+
+        if (threadCmdPool->managerId == manager->id &&
+            threadCmdPool->queueFamilyIndex == queueFamilyIndex) {
+            return threadCmdPool->cmdPool;
+        }
+    }
+
+    CmdPool* cmdPool = findCmdPool(manager, queueFamilyIndex);
+    if (cmdPool == NULL) {
+        cmdPool = createCmdPool(manager, queueFamilyIndex);
+    }
+
+    if (cmdPool != NULL) {
+        mThreadCmdPools[mNextThreadCmdPool] = (ThreadCmdPool) {
+            .managerId = manager->id,
+            .queueFamilyIndex = queueFamilyIndex,
+            .cmdPool = cmdPool,
+        };
+        mNextThreadCmdPool = (mNextThreadCmdPool + 1) % MAX_THREAD_CMD_POOLS;
+    }
+
+    return cmdPool;
+}
+
+// Returns a command buffer that can be recorded on the calling thread. The current command buffer
+// is kept if it comes from the thread's pool, otherwise it's released and replaced.
+VkCommandBuffer getThreadVkCommandBuffer(
+    CmdPoolManager* manager,
+    uint32_t queueFamilyIndex,
+    CmdPool** pCmdPool,
+    VkCommandBuffer commandBuffer)
+{
+    CmdPool* cmdPool = getThreadCmdPool(manager, queueFamilyIndex);
+
+    if (cmdPool == NULL) {
+        return VK_NULL_HANDLE;
+    } else if (cmdPool == *pCmdPool && commandBuffer != VK_NULL_HANDLE) {
+        return commandBuffer;
+    }
+
+    if (*pCmdPool != NULL && commandBuffer != VK_NULL_HANDLE) {
+        releaseCmdPoolCommandBuffer(*pCmdPool, commandBuffer);
+    }
+
+    *pCmdPool = cmdPool;
+    return allocCmdPoolCommandBuffer(cmdPool);
+}
+
+// Can be called from any thread
+void releaseCmdPoolCommandBuffer(
+    CmdPool* cmdPool,
+    VkCommandBuffer commandBuffer)
+{
+    if (cmdPool->threadId == GetCurrentThreadId()) {
+        retireCommandBuffers(cmdPool, 1, &commandBuffer);
+        return;
+    }
+
+    EnterCriticalSection(&cmdPool->pendingLock);
+    appendCommandBuffers(&cmdPool->pendingReleases, &cmdPool->pendingReleaseCount,
+                         &cmdPool->pendingReleaseCapacity, 1, &commandBuffer);
+    LeaveCriticalSection(&cmdPool->pendingLock);
+}
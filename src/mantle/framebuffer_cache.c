@@ -0,0 +1,186 @@
+#include "mantle_internal.h"
+
+#define FRAMEBUFFER_CACHE_BUCKET_COUNT 256
+#define MAX_ATTACHMENT_COUNT (GR_MAX_COLOR_TARGETS + 1)
+
+// Attachment formats stand in for render pass compatibility, so that pipelines with different
+// but compatible render passes share framebuffers
+typedef struct _FramebufferKey {
+    uint32_t attachmentCount;
+    VkFormat formats[MAX_ATTACHMENT_COUNT];
+    VkImageView attachments[MAX_ATTACHMENT_COUNT];
+    VkExtent2D extent;
+} FramebufferKey;
+
+typedef struct _FramebufferEntry {
+    struct _FramebufferEntry* next;
+    FramebufferKey key;
+    VkFramebuffer framebuffer;
+} FramebufferEntry;
+
+struct _FramebufferCache {
+    VkDevice device;
+    CRITICAL_SECTION lock;
+    FramebufferEntry* buckets[FRAMEBUFFER_CACHE_BUCKET_COUNT];
+    uint64_t hitCount;
+    uint64_t missCount;
+};
+
+static uint32_t hashFramebufferKey(
+    const FramebufferKey* key)
+{
+    // FNV-1a
+    const uint8_t* data = (const uint8_t*)key;
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < sizeof(FramebufferKey); i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+FramebufferCache* createFramebufferCache(
+    VkDevice device)
+{
+    FramebufferCache* cache = malloc(sizeof(FramebufferCache));
+    *cache = (FramebufferCache) {
+        .device = device,
+        .buckets = { NULL },
+        .hitCount = 0,
+        .missCount = 0,
+    };
+
+    InitializeCriticalSection(&cache->lock);
+
+    return cache;
+}
+
+void destroyFramebufferCache(
+    FramebufferCache* cache)
+{
+    for (int i = 0; i < FRAMEBUFFER_CACHE_BUCKET_COUNT; i++) {
+        FramebufferEntry* entry = cache->buckets[i];
+
+        while (entry != NULL) {
+            FramebufferEntry* next = entry->next;
+
+            vki.vkDestroyFramebuffer(cache->device, entry->framebuffer, NULL);
+            free(entry);
+            entry = next;
+        }
+    }
+
+    DeleteCriticalSection(&cache->lock);
+    free(cache);
+}
+
+VkFramebuffer getCachedVkFramebuffer(
+    FramebufferCache* cache,
+    VkRenderPass renderPass,
+    uint32_t attachmentCount,
+    const VkImageView* pAttachments,
+    const VkFormat* pFormats,
+    VkExtent2D extent)
+{
+    FramebufferKey key;
+
+    assert(attachmentCount <= MAX_ATTACHMENT_COUNT);
+
+    // Zero out padding and unused slots so the key can be hashed and compared bytewise
+    memset(&key, 0, sizeof(key));
+    key.attachmentCount = attachmentCount;
+    memcpy(key.formats, pFormats, sizeof(VkFormat) * attachmentCount);
+    memcpy(key.attachments, pAttachments, sizeof(VkImageView) * attachmentCount);
+    key.extent = extent;
+
+    uint32_t bucketIdx = hashFramebufferKey(&key) % FRAMEBUFFER_CACHE_BUCKET_COUNT;
+
+    EnterCriticalSection(&cache->lock);
+
+    for (FramebufferEntry* entry = cache->buckets[bucketIdx]; entry != NULL; entry = entry->next) {
+        if (memcmp(&entry->key, &key, sizeof(key)) == 0) {
+            cache->hitCount++;
+            LeaveCriticalSection(&cache->lock);
+            return entry->framebuffer;
+        }
+    }
+
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    const VkFramebufferCreateInfo framebufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .renderPass = renderPass,
+        .attachmentCount = attachmentCount,
+        .pAttachments = pAttachments,
+        .width = extent.width,
+        .height = extent.height,
+        .layers = 1, // FIXME hardcoded
+    };
+
+    if (vki.vkCreateFramebuffer(cache->device, &framebufferCreateInfo, NULL,
+                                &framebuffer) != VK_SUCCESS) {
+        printf("%s: vkCreateFramebuffer failed\n", __func__);
+        LeaveCriticalSection(&cache->lock);
+        return VK_NULL_HANDLE;
+    }
+
+    FramebufferEntry* entry = malloc(sizeof(FramebufferEntry));
+    *entry = (FramebufferEntry) {
+        .next = cache->buckets[bucketIdx],
+        .key = key,
+        .framebuffer = framebuffer,
+    };
+
+    cache->buckets[bucketIdx] = entry;
+    cache->missCount++;
+
+    LeaveCriticalSection(&cache->lock);
+    return framebuffer;
+}
+
+void invalidateFramebufferCacheView(
+    FramebufferCache* cache,
+    VkImageView imageView)
+{
+    EnterCriticalSection(&cache->lock);
+
+    for (int i = 0; i < FRAMEBUFFER_CACHE_BUCKET_COUNT; i++) {
+        FramebufferEntry** link = &cache->buckets[i];
+
+        while (*link != NULL) {
+            FramebufferEntry* entry = *link;
+            bool usesView = false;
+
+            for (int j = 0; j < entry->key.attachmentCount; j++) {
+                if (entry->key.attachments[j] == imageView) {
+                    usesView = true;
+                    break;
+                }
+            }
+
+            if (usesView) {
+                vki.vkDestroyFramebuffer(cache->device, entry->framebuffer, NULL);
+                *link = entry->next;
+                free(entry);
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+
+    LeaveCriticalSection(&cache->lock);
+}
+
+void getFramebufferCacheStats(
+    FramebufferCache* cache,
+    uint64_t* pHitCount,
+    uint64_t* pMissCount)
+{
+    EnterCriticalSection(&cache->lock);
+    *pHitCount = cache->hitCount;
+    *pMissCount = cache->missCount;
+    LeaveCriticalSection(&cache->lock);
+}
@@ -0,0 +1,233 @@
+#include "mantle_internal.h"
+
+#define IMAGE_PLANE_COUNT 2 // Color or depth, stencil
+#define IMAGE_STATE_UNKNOWN 0
+
+#define VK_ACCESS_WRITE_MASK \
+    (VK_ACCESS_SHADER_WRITE_BIT | \
+     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | \
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | \
+     VK_ACCESS_TRANSFER_WRITE_BIT | \
+     VK_ACCESS_HOST_WRITE_BIT | \
+     VK_ACCESS_MEMORY_WRITE_BIT)
+
+// Mantle states of every subresource of an image used in a command buffer
+typedef struct _ImageStateEntry {
+    GrImage* grImage;
+    GR_IMAGE_STATE* firstStates;
+    GR_IMAGE_STATE* states;
+    VkPipelineStageFlags* readStages; // Stages synchronized with the last write
+} ImageStateEntry;
+
+struct _ImageStateTracker {
+    ImageStateEntry* entries;
+    uint32_t entryCount;
+    uint32_t entryCapacity;
+};
+
+static uint32_t getSubresourceCount(
+    const GrImage* grImage)
+{
+    return IMAGE_PLANE_COUNT * grImage->mipLevels * grImage->arrayLayers;
+}
+
+static uint32_t getSubresourceIndex(
+    const GrImage* grImage,
+    uint32_t plane,
+    uint32_t mipLevel,
+    uint32_t arrayLayer)
+{
+    return (plane * grImage->mipLevels + mipLevel) * grImage->arrayLayers + arrayLayer;
+}
+
+static ImageStateEntry* getImageStateEntry(
+    ImageStateTracker* tracker,
+    GrImage* grImage)
+{
+    for (int i = 0; i < tracker->entryCount; i++) {
+        if (tracker->entries[i].grImage == grImage) {
+            return &tracker->entries[i];
+        }
+    }
+
+    if (tracker->entryCount == tracker->entryCapacity) {
+        tracker->entryCapacity = tracker->entryCapacity == 0 ? 16 : tracker->entryCapacity * 2;
+        tracker->entries = realloc(tracker->entries,
+                                   sizeof(ImageStateEntry) * tracker->entryCapacity);
+    }
+
+    uint32_t subresourceCount = getSubresourceCount(grImage);
+    ImageStateEntry* entry = &tracker->entries[tracker->entryCount];
+    *entry = (ImageStateEntry) {
+        .grImage = grImage,
+        .firstStates = calloc(subresourceCount, sizeof(GR_IMAGE_STATE)),
+        .states = calloc(subresourceCount, sizeof(GR_IMAGE_STATE)),
+        .readStages = calloc(subresourceCount, sizeof(VkPipelineStageFlags)),
+    };
+
+    tracker->entryCount++;
+    return entry;
+}
+
+ImageStateTracker* createImageStateTracker()
+{
+    ImageStateTracker* tracker = malloc(sizeof(ImageStateTracker));
+    *tracker = (ImageStateTracker) {
+        .entries = NULL,
+        .entryCount = 0,
+        .entryCapacity = 0,
+    };
+
+    return tracker;
+}
+
+void destroyImageStateTracker(
+    ImageStateTracker* tracker)
+{
+    resetImageStateTracker(tracker);
+    free(tracker->entries);
+    free(tracker);
+}
+
+void resetImageStateTracker(
+    ImageStateTracker* tracker)
+{
+    for (int i = 0; i < tracker->entryCount; i++) {
+        free(tracker->entries[i].firstStates);
+        free(tracker->entries[i].states);
+        free(tracker->entries[i].readStages);
+    }
+
+    tracker->entryCount = 0;
+}
+
+// Records a transition and returns false if it has no effect and can be skipped
+bool updateImageState(
+    ImageStateTracker* tracker,
+    GrImage* grImage,
+    const VkImageSubresourceRange* range,
+    GR_IMAGE_STATE oldState,
+    GR_IMAGE_STATE newState)
+{
+    ImageStateEntry* entry = getImageStateEntry(tracker, grImage);
+    VkAccessFlags oldAccess = getVkAccessFlagsImage(oldState);
+    VkAccessFlags newAccess = getVkAccessFlagsImage(newState);
+    VkPipelineStageFlags newStages = getVkPipelineStageFlagsImage(newState);
+    bool isReadOnly = (newAccess & VK_ACCESS_WRITE_MASK) == 0;
+    bool isNoop = isReadOnly &&
+                  getVkImageLayout(oldState) == getVkImageLayout(newState) &&
+                  oldAccess == newAccess;
+    bool isRepeated = isReadOnly;
+
+    uint32_t levelCount = range->levelCount == VK_REMAINING_MIP_LEVELS ?
+                          grImage->mipLevels - range->baseMipLevel : range->levelCount;
+    uint32_t layerCount = range->layerCount == VK_REMAINING_ARRAY_LAYERS ?
+                          grImage->arrayLayers - range->baseArrayLayer : range->layerCount;
+
+    for (int plane = 0; plane < IMAGE_PLANE_COUNT; plane++) {
+        VkImageAspectFlags planeAspect = plane == 0 ?
+            VK_IMAGE_ASPECT_COLOR_BIT | VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_STENCIL_BIT;
+
+        if ((range->aspectMask & planeAspect) == 0) {
+            continue;
+        }
+
+        for (int i = 0; i < levelCount; i++) {
+            for (int j = 0; j < layerCount; j++) {
+                uint32_t idx = getSubresourceIndex(grImage, plane, range->baseMipLevel + i,
+                                                   range->baseArrayLayer + j);
+
+                // Without a previous transition in this command buffer, the stages of the old
+                // state are the ones the application synchronized with the last write
+                VkPipelineStageFlags coveredStages = entry->readStages[idx];
+                if (entry->states[idx] == IMAGE_STATE_UNKNOWN &&
+                    (oldAccess & VK_ACCESS_WRITE_MASK) == 0) {
+                    coveredStages = getVkPipelineStageFlagsImage(oldState);
+                }
+
+                // Reads from other stages still need the barrier to see the last write
+                if ((newStages & ~coveredStages) != 0) {
+                    isNoop = false;
+                    isRepeated = false;
+                }
+                if (entry->states[idx] != newState) {
+                    isRepeated = false;
+                }
+                if (entry->firstStates[idx] == IMAGE_STATE_UNKNOWN) {
+                    entry->firstStates[idx] = oldState;
+                }
+                entry->states[idx] = newState;
+                entry->readStages[idx] = isReadOnly ? coveredStages | newStages : 0;
+            }
+        }
+    }
+
+    return !isNoop && !isRepeated;
+}
+
+// Returns the layout of a subresource after the last transition recorded so far, or
+// VK_IMAGE_LAYOUT_MAX_ENUM if the command buffer didn't transition it yet
+VkImageLayout getImageStateLayout(
+    const ImageStateTracker* tracker,
+    const GrImage* grImage,
+    VkImageAspectFlags aspectMask,
+    uint32_t mipLevel,
+    uint32_t arrayLayer)
+{
+    uint32_t plane = aspectMask == VK_IMAGE_ASPECT_STENCIL_BIT ? 1 : 0;
+    uint32_t idx = getSubresourceIndex(grImage, plane, mipLevel, arrayLayer);
+
+    for (int i = 0; i < tracker->entryCount; i++) {
+        const ImageStateEntry* entry = &tracker->entries[i];
+
+        if (entry->grImage == grImage && entry->states[idx] != IMAGE_STATE_UNKNOWN) {
+            return getVkImageLayout(entry->states[idx]);
+        }
+    }
+
+    return VK_IMAGE_LAYOUT_MAX_ENUM;
+}
+
+// Checks the states expected by a submitted command buffer against the last known image layouts,
+// then updates them with the final states of the command buffer
+void commitImageStates(
+    ImageStateTracker* tracker)
+{
+    // TODO synchronize with submissions on other queues
+    for (int i = 0; i < tracker->entryCount; i++) {
+        const ImageStateEntry* entry = &tracker->entries[i];
+        GrImage* grImage = entry->grImage;
+
+        for (int j = 0; j < getSubresourceCount(grImage); j++) {
+            if (entry->firstStates[j] == IMAGE_STATE_UNKNOWN) {
+                continue;
+            }
+
+            VkImageLayout expectedLayout = getVkImageLayout(entry->firstStates[j]);
+            VkImageLayout knownLayout = grImage->layouts[j];
+
+            if (expectedLayout != VK_IMAGE_LAYOUT_UNDEFINED &&
+                knownLayout != VK_IMAGE_LAYOUT_MAX_ENUM &&
+                expectedLayout != knownLayout) {
+                printf("%s: image %p subresource %d is in layout %d, expected %d\n",
+                       __func__, grImage, j, knownLayout, expectedLayout);
+            }
+
+            grImage->layouts[j] = getVkImageLayout(entry->states[j]);
+        }
+    }
+}
+
+VkImageLayout* createImageLayouts(
+    const GrImage* grImage)
+{
+    uint32_t subresourceCount = getSubresourceCount(grImage);
+    VkImageLayout* layouts = malloc(sizeof(VkImageLayout) * subresourceCount);
+
+    // Layouts are unknown until the image is first used in a submission
+    for (int i = 0; i < subresourceCount; i++) {
+        layouts[i] = VK_IMAGE_LAYOUT_MAX_ENUM;
+    }
+
+    return layouts;
+}
@@ -1,5 +1,135 @@
 #include "mantle_internal.h"
 
+typedef enum _CmdType {
+    CMD_NOP,
+    CMD_BIND_PIPELINE,
+    CMD_BIND_STATE_OBJECT,
+    CMD_BIND_DESCRIPTOR_SET,
+    CMD_BIND_TARGETS,
+    CMD_BIND_INDEX_DATA,
+    CMD_BIND_DYNAMIC_MEMORY_VIEW,
+    CMD_BARRIER,
+    CMD_DRAW,
+    CMD_DRAW_INDEXED,
+    CMD_DRAW_INDIRECT,
+    CMD_DRAW_INDEXED_INDIRECT,
+    CMD_DISPATCH,
+    CMD_DISPATCH_INDIRECT,
+    CMD_COPY_BUFFER,
+    CMD_COPY_IMAGE,
+    CMD_COPY_BUFFER_TO_IMAGE,
+    CMD_COPY_IMAGE_TO_BUFFER,
+    CMD_RESOLVE_IMAGE,
+    CMD_FILL_BUFFER,
+    CMD_CLEAR_COLOR_IMAGE,
+    CMD_CLEAR_DEPTH_STENCIL,
+    CMD_DISCARD_IMAGE,
+} CmdType;
+
+// Recorded command, lowered to Vulkan calls at the end of the command buffer
+struct _CmdEntry {
+    CmdEntry* next;
+    CmdType type;
+    union {
+        struct {
+            GR_PIPELINE_BIND_POINT bindPoint;
+            GrPipeline* grPipeline;
+        } bindPipeline;
+        struct {
+            GR_STATE_BIND_POINT bindPoint;
+            GrObject* state;
+        } bindStateObject;
+        struct {
+            GR_PIPELINE_BIND_POINT bindPoint;
+            GrDescriptorSet* grDescriptorSet;
+        } bindDescriptorSet;
+        struct {
+            uint32_t colorTargetCount;
+            GR_COLOR_TARGET_BIND_INFO* colorTargets;
+            GR_DEPTH_STENCIL_BIND_INFO* depthTarget;
+        } bindTargets;
+        struct {
+            GrGpuMemory* grGpuMemory;
+            VkDeviceSize offset;
+            VkIndexType indexType;
+        } bindIndexData;
+        struct {
+            GR_PIPELINE_BIND_POINT bindPoint;
+            VkDescriptorBufferInfo bufferInfo;
+        } bindDynamicMemoryView;
+        struct {
+            VkPipelineStageFlags srcStageMask;
+            VkPipelineStageFlags dstStageMask;
+            uint32_t bufferBarrierCount;
+            VkBufferMemoryBarrier* bufferBarriers;
+            uint32_t imageBarrierCount;
+            VkImageMemoryBarrier* imageBarriers;
+            GrImage* clearedTarget; // Only transitions this target around an attachment clear
+        } barrier;
+        struct {
+            uint32_t firstVertex;
+            uint32_t vertexCount;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+        } draw;
+        struct {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            int32_t vertexOffset;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+        } drawIndexed;
+        struct {
+            GrGpuMemory* grGpuMemory;
+            VkDeviceSize offset;
+            uint32_t drawCount; // Consecutive argument records
+        } drawIndirect;
+        struct {
+            uint32_t x;
+            uint32_t y;
+            uint32_t z;
+        } dispatch;
+        struct {
+            GrGpuMemory* grGpuMemory;
+            VkDeviceSize offset;
+        } dispatchIndirect;
+        struct {
+            VkBuffer srcBuffer;
+            VkBuffer dstBuffer;
+            GrImage* srcImage;
+            GrImage* dstImage;
+            VkImageLayout srcLayout;
+            VkImageLayout dstLayout;
+            uint32_t regionCount;
+            union {
+                void* regions;
+                VkBufferCopy* bufferRegions;
+                VkImageCopy* imageRegions;
+                VkImageResolve* resolveRegions;
+                VkBufferImageCopy* bufferImageRegions;
+            };
+        } copy; // Unused buffers and images are left null
+        struct {
+            VkBuffer dstBuffer;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            uint32_t data;
+        } fillBuffer;
+        struct {
+            GrImage* grImage;
+            VkClearValue clearValue;
+            uint32_t rangeCount;
+            VkImageSubresourceRange* ranges;
+            bool isFolded; // Turned into a load op of the next render pass
+            bool isAttachmentClear; // Can be done within the active render pass
+        } clearImage;
+        struct {
+            GrImage* grImage;
+            VkImageAspectFlags aspectMask;
+        } discardImage;
+    };
+};
+
 static VkImageSubresourceRange getVkImageSubresourceRange(
     const GR_IMAGE_SUBRESOURCE_RANGE* range)
 {
@@ -14,88 +144,2010 @@ static VkImageSubresourceRange getVkImageSubresourceRange(
     };
 }
 
-static VkFramebuffer getVkFramebuffer(
-    VkDevice device,
-    VkRenderPass renderPass,
-    uint32_t colorTargetCount,
-    const GR_COLOR_TARGET_BIND_INFO* pColorTargets,
-    const GR_DEPTH_STENCIL_BIND_INFO* pDepthTarget)
+static VkImageSubresourceLayers getVkImageSubresourceLayers(
+    const GR_IMAGE_SUBRESOURCE* subresource)
+{
+    return (VkImageSubresourceLayers) {
+        .aspectMask = getVkImageAspectFlags(subresource->aspect),
+        .mipLevel = subresource->mipLevel,
+        .baseArrayLayer = subresource->arraySlice,
+        .layerCount = 1,
+    };
+}
+
+static bool mergeSubresourceRanges(
+    uint32_t* pBase,
+    uint32_t* pCount,
+    uint32_t otherBase,
+    uint32_t otherCount)
+{
+    // Ranges extending to the last mip or slice can only be merged with a range preceding them
+    // (VK_REMAINING_MIP_LEVELS and VK_REMAINING_ARRAY_LAYERS have the same value)
+    if (*pCount != VK_REMAINING_MIP_LEVELS && *pBase + *pCount == otherBase) {
+        *pCount = otherCount == VK_REMAINING_MIP_LEVELS ? otherCount : *pCount + otherCount;
+        return true;
+    } else if (otherCount != VK_REMAINING_MIP_LEVELS && otherBase + otherCount == *pBase) {
+        *pCount = *pCount == VK_REMAINING_MIP_LEVELS ? *pCount : *pCount + otherCount;
+        *pBase = otherBase;
+        return true;
+    }
+
+    return false;
+}
+
+// Merges two image barriers with the same transition if their subresource ranges are adjacent
+static bool mergeImageMemoryBarriers(
+    VkImageMemoryBarrier* barrier,
+    const VkImageMemoryBarrier* other)
+{
+    VkImageSubresourceRange* range = &barrier->subresourceRange;
+    const VkImageSubresourceRange* otherRange = &other->subresourceRange;
+
+    if (barrier->image != other->image ||
+        barrier->oldLayout != other->oldLayout ||
+        barrier->newLayout != other->newLayout ||
+        barrier->srcAccessMask != other->srcAccessMask ||
+        barrier->dstAccessMask != other->dstAccessMask ||
+        range->aspectMask != otherRange->aspectMask) {
+        return false;
+    }
+
+    if (range->baseMipLevel == otherRange->baseMipLevel &&
+        range->levelCount == otherRange->levelCount) {
+        return mergeSubresourceRanges(&range->baseArrayLayer, &range->layerCount,
+                                      otherRange->baseArrayLayer, otherRange->layerCount);
+    } else if (range->baseArrayLayer == otherRange->baseArrayLayer &&
+               range->layerCount == otherRange->layerCount) {
+        return mergeSubresourceRanges(&range->baseMipLevel, &range->levelCount,
+                                      otherRange->baseMipLevel, otherRange->levelCount);
+    }
+
+    return false;
+}
+
+// Merges two buffer barriers with the same transition if their ranges are adjacent
+static bool mergeBufferMemoryBarriers(
+    VkBufferMemoryBarrier* barrier,
+    const VkBufferMemoryBarrier* other)
+{
+    if (barrier->buffer != other->buffer ||
+        barrier->srcAccessMask != other->srcAccessMask ||
+        barrier->dstAccessMask != other->dstAccessMask) {
+        return false;
+    }
+
+    if (barrier->size != VK_WHOLE_SIZE && barrier->offset + barrier->size == other->offset) {
+        barrier->size = other->size == VK_WHOLE_SIZE ? other->size : barrier->size + other->size;
+        return true;
+    } else if (other->size != VK_WHOLE_SIZE && other->offset + other->size == barrier->offset) {
+        barrier->size = barrier->size == VK_WHOLE_SIZE ? barrier->size : barrier->size + other->size;
+        barrier->offset = other->offset;
+        return true;
+    }
+
+    return false;
+}
+
+static VkFramebuffer getVkFramebuffer(
+    GrDevice* grDevice,
+    VkRenderPass renderPass,
+    uint32_t colorTargetCount,
+    const GR_COLOR_TARGET_BIND_INFO* pColorTargets,
+    const GR_DEPTH_STENCIL_BIND_INFO* pDepthTarget,
+    VkExtent2D* pExtent)
+{
+    VkImageView attachments[GR_MAX_COLOR_TARGETS + 1];
+    VkFormat formats[GR_MAX_COLOR_TARGETS + 1];
+    VkExtent2D extent = { UINT32_MAX, UINT32_MAX };
+    int attachmentIdx = 0;
+
+    for (int i = 0; i < colorTargetCount; i++) {
+        GrColorTargetView* grColorTargetView = (GrColorTargetView*)pColorTargets[i].view;
+
+        if (grColorTargetView == NULL) {
+            continue;
+        }
+
+        attachments[attachmentIdx] = grColorTargetView->imageView;
+        formats[attachmentIdx] = grColorTargetView->format;
+        extent.width = MIN(extent.width, grColorTargetView->extent.width);
+        extent.height = MIN(extent.height, grColorTargetView->extent.height);
+        attachmentIdx++;
+    }
+
+    if (pDepthTarget != NULL && pDepthTarget->view != GR_NULL_HANDLE) {
+        GrDepthStencilView* grDepthStencilView = (GrDepthStencilView*)pDepthTarget->view;
+
+        attachments[attachmentIdx] = grDepthStencilView->imageView;
+        formats[attachmentIdx] = grDepthStencilView->format;
+        extent.width = MIN(extent.width, grDepthStencilView->extent.width);
+        extent.height = MIN(extent.height, grDepthStencilView->extent.height);
+        attachmentIdx++;
+    }
+
+    if (attachmentIdx == 0) {
+        // TODO handle rendering without attachments
+        printf("%s: no targets bound\n", __func__);
+        return VK_NULL_HANDLE;
+    }
+
+    *pExtent = extent;
+    return getCachedVkFramebuffer(grDevice->framebufferCache, renderPass,
+                                  attachmentIdx, attachments, formats, extent);
+}
+
+static bool isAttachmentLayout(
+    VkImageLayout layout)
+{
+    return layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL ||
+           layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL ||
+           layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL ||
+           layout == VK_IMAGE_LAYOUT_STENCIL_ATTACHMENT_OPTIMAL;
+}
+
+// Checks if the image is one of the bound targets and the render area, limited by the smallest
+// target, covers all of it
+static bool isTargetCovered(
+    const CmdEntry* bindTargetsEntry,
+    const GrImage* grImage)
+{
+    VkExtent2D extent = { UINT32_MAX, UINT32_MAX };
+    bool isBound = false;
+
+    if (bindTargetsEntry == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < bindTargetsEntry->bindTargets.colorTargetCount; i++) {
+        const GrColorTargetView* grColorTargetView =
+            (GrColorTargetView*)bindTargetsEntry->bindTargets.colorTargets[i].view;
+
+        if (grColorTargetView == NULL) {
+            continue;
+        }
+
+        isBound |= grColorTargetView->grImage == grImage;
+        extent.width = MIN(extent.width, grColorTargetView->extent.width);
+        extent.height = MIN(extent.height, grColorTargetView->extent.height);
+    }
+
+    const GR_DEPTH_STENCIL_BIND_INFO* depthTarget = bindTargetsEntry->bindTargets.depthTarget;
+    if (depthTarget != NULL && depthTarget->view != GR_NULL_HANDLE) {
+        const GrDepthStencilView* grDepthStencilView = (GrDepthStencilView*)depthTarget->view;
+
+        isBound |= grDepthStencilView->grImage == grImage;
+        extent.width = MIN(extent.width, grDepthStencilView->extent.width);
+        extent.height = MIN(extent.height, grDepthStencilView->extent.height);
+    }
+
+    return isBound &&
+           extent.width == grImage->extent.width &&
+           extent.height == grImage->extent.height;
+}
+
+static void removePendingLoadOps(
+    GrCmdBuffer* grCmdBuffer,
+    VkImage image)
+{
+    uint32_t pendingLoadOpCount = 0;
+
+    for (int i = 0; i < grCmdBuffer->pendingLoadOpCount; i++) {
+        const PendingLoadOp* pendingLoadOp = &grCmdBuffer->pendingLoadOps[i];
+
+        if (pendingLoadOp->aspectMask != 0 && pendingLoadOp->image != image) {
+            grCmdBuffer->pendingLoadOps[pendingLoadOpCount] = *pendingLoadOp;
+            pendingLoadOpCount++;
+        }
+    }
+
+    grCmdBuffer->pendingLoadOpCount = pendingLoadOpCount;
+}
+
+static void addPendingLoadOp(
+    GrCmdBuffer* grCmdBuffer,
+    VkImage image,
+    VkImageAspectFlags aspectMask,
+    VkAttachmentLoadOp loadOp,
+    const VkClearValue* clearValue)
+{
+    removePendingLoadOps(grCmdBuffer, image);
+
+    if (grCmdBuffer->pendingLoadOpCount == MAX_PENDING_LOAD_OP_COUNT) {
+        // Fall back to loading the attachment
+        return;
+    }
+
+    grCmdBuffer->pendingLoadOps[grCmdBuffer->pendingLoadOpCount] = (PendingLoadOp) {
+        .image = image,
+        .aspectMask = aspectMask,
+        .loadOp = loadOp,
+        .clearValue = clearValue != NULL ? *clearValue : (VkClearValue) {},
+    };
+    grCmdBuffer->pendingLoadOpCount++;
+}
+
+static VkAttachmentLoadOp takePendingLoadOp(
+    GrCmdBuffer* grCmdBuffer,
+    const GrImage* grImage,
+    VkImageAspectFlags aspectMask,
+    VkClearValue* pClearValue)
+{
+    for (int i = 0; i < grCmdBuffer->pendingLoadOpCount; i++) {
+        PendingLoadOp* pendingLoadOp = &grCmdBuffer->pendingLoadOps[i];
+
+        if (pendingLoadOp->image == grImage->image &&
+            (pendingLoadOp->aspectMask & aspectMask) != 0) {
+            pendingLoadOp->aspectMask &= ~aspectMask;
+
+            // The transition might not have covered every subresource of the image
+            if (pendingLoadOp->loadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE &&
+                (grImage->mipLevels != 1 || grImage->arrayLayers != 1)) {
+                return VK_ATTACHMENT_LOAD_OP_LOAD;
+            }
+
+            *pClearValue = pendingLoadOp->clearValue;
+            return pendingLoadOp->loadOp;
+        }
+    }
+
+    return VK_ATTACHMENT_LOAD_OP_LOAD;
+}
+
+static bool isImageCopied(
+    const CmdEntry* entry,
+    const GrImage* grImage)
+{
+    return entry->copy.srcImage == grImage || entry->copy.dstImage == grImage;
+}
+
+// Checks if the image gets discarded before the render pass can end. Draws and binds keeping the
+// pass compatible don't end it, anything else might have a later pass load the image.
+static bool isDiscardedAfter(
+    const CmdEntry* entry,
+    const AttachmentFormats* formats,
+    const GrImage* grImage,
+    VkImageAspectFlags aspectMask)
+{
+    // The render pass only stores the subresource of the view
+    if (grImage->mipLevels != 1 || grImage->arrayLayers != 1) {
+        return false;
+    }
+
+    for (entry = entry->next; entry != NULL; entry = entry->next) {
+        switch (entry->type) {
+        case CMD_DISCARD_IMAGE:
+            if (entry->discardImage.grImage == grImage &&
+                (entry->discardImage.aspectMask & aspectMask) == aspectMask) {
+                return true;
+            }
+            break;
+        case CMD_BIND_PIPELINE:
+            // Matches the check done when binding the pipeline at draw time
+            if (entry->bindPipeline.bindPoint == GR_PIPELINE_BIND_POINT_GRAPHICS &&
+                memcmp(formats, &entry->bindPipeline.grPipeline->attachmentFormats,
+                       sizeof(AttachmentFormats)) != 0) {
+                return false;
+            }
+            break;
+        case CMD_NOP:
+        case CMD_BIND_STATE_OBJECT:
+        case CMD_BIND_DESCRIPTOR_SET:
+        case CMD_BIND_INDEX_DATA:
+        case CMD_BIND_DYNAMIC_MEMORY_VIEW:
+        case CMD_DRAW:
+        case CMD_DRAW_INDEXED:
+        case CMD_DRAW_INDIRECT:
+        case CMD_DRAW_INDEXED_INDIRECT:
+            break;
+        case CMD_BIND_TARGETS:
+        case CMD_BARRIER:
+        case CMD_DISPATCH:
+        case CMD_DISPATCH_INDIRECT:
+        case CMD_COPY_BUFFER:
+        case CMD_COPY_IMAGE:
+        case CMD_COPY_BUFFER_TO_IMAGE:
+        case CMD_COPY_IMAGE_TO_BUFFER:
+        case CMD_RESOLVE_IMAGE:
+        case CMD_FILL_BUFFER:
+        case CMD_CLEAR_COLOR_IMAGE:
+        case CMD_CLEAR_DEPTH_STENCIL:
+            return false;
+        }
+    }
+
+    return false;
+}
+
+static VkAttachmentStoreOp getStoreOp(
+    const CmdEntry* entry,
+    const AttachmentFormats* formats,
+    const GrImage* grImage,
+    VkImageAspectFlags aspectMask)
+{
+    return isDiscardedAfter(entry, formats, grImage, aspectMask) ?
+           VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+}
+
+// Picks the load and store ops of the bound targets for a render pass beginning at the given
+// entry, returns the number of attachments
+static uint32_t getAttachmentOps(
+    GrCmdBuffer* grCmdBuffer,
+    const CmdEntry* entry,
+    AttachmentOps* pOps,
+    VkClearValue* pClearValues)
+{
+    const AttachmentFormats* formats = &grCmdBuffer->grPipeline->attachmentFormats;
+    int attachmentIdx = 0;
+
+    *pOps = (AttachmentOps) {
+        .colorLoadOps = { VK_ATTACHMENT_LOAD_OP_LOAD },
+        .colorStoreOps = { VK_ATTACHMENT_STORE_OP_STORE },
+        .depthLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .depthStoreOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE,
+    };
+
+    for (int i = 0; i < grCmdBuffer->colorTargetCount; i++) {
+        GrColorTargetView* grColorTargetView =
+            (GrColorTargetView*)grCmdBuffer->colorTargets[i].view;
+
+        if (grColorTargetView == NULL) {
+            continue;
+        }
+
+        pOps->colorLoadOps[attachmentIdx] =
+            takePendingLoadOp(grCmdBuffer, grColorTargetView->grImage, VK_IMAGE_ASPECT_COLOR_BIT,
+                              &pClearValues[attachmentIdx]);
+        pOps->colorStoreOps[attachmentIdx] =
+            getStoreOp(entry, formats, grColorTargetView->grImage, VK_IMAGE_ASPECT_COLOR_BIT);
+        attachmentIdx++;
+    }
+
+    if (grCmdBuffer->hasDepthTarget && grCmdBuffer->depthTarget.view != GR_NULL_HANDLE) {
+        GrDepthStencilView* grDepthStencilView =
+            (GrDepthStencilView*)grCmdBuffer->depthTarget.view;
+        GrImage* grImage = grDepthStencilView->grImage;
+        VkClearValue clearValue = { .depthStencil = { 0.f, 0 } };
+
+        pOps->depthLoadOp = takePendingLoadOp(grCmdBuffer, grImage,
+                                              VK_IMAGE_ASPECT_DEPTH_BIT, &clearValue);
+        pOps->depthStoreOp = getStoreOp(entry, formats, grImage, VK_IMAGE_ASPECT_DEPTH_BIT);
+        pOps->stencilLoadOp = takePendingLoadOp(grCmdBuffer, grImage,
+                                                VK_IMAGE_ASPECT_STENCIL_BIT, &clearValue);
+        pOps->stencilStoreOp = getStoreOp(entry, formats, grImage, VK_IMAGE_ASPECT_STENCIL_BIT);
+        pClearValues[attachmentIdx] = clearValue;
+        attachmentIdx++;
+    }
+
+    return attachmentIdx;
+}
+
+// Returns true if the dynamic state has to be emitted, false if it matches what was last emitted
+static bool testDynamicState(
+    GrCmdBuffer* grCmdBuffer,
+    DynamicStateBit stateBit,
+    bool isEqual)
+{
+    if ((grCmdBuffer->validDynamicStateFlags & stateBit) && isEqual) {
+        grCmdBuffer->stats.skippedDynamicStateCallCount++;
+        return false;
+    }
+
+    grCmdBuffer->validDynamicStateFlags |= stateBit;
+    grCmdBuffer->stats.dynamicStateCallCount++;
+    return true;
+}
+
+static void flushViewportState(
+    GrCmdBuffer* grCmdBuffer,
+    const GrViewportStateObject* viewportState)
+{
+    VkCommandBuffer vkCommandBuffer = grCmdBuffer->commandBuffer;
+    DynamicState* dynamicState = &grCmdBuffer->dynamicState;
+
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_VIEWPORT,
+                         dynamicState->viewportCount == viewportState->viewportCount &&
+                         memcmp(dynamicState->viewports, viewportState->viewports,
+                                sizeof(VkViewport) * viewportState->viewportCount) == 0)) {
+        dynamicState->viewportCount = viewportState->viewportCount;
+        memcpy(dynamicState->viewports, viewportState->viewports,
+               sizeof(VkViewport) * viewportState->viewportCount);
+        vki.vkCmdSetViewportWithCountEXT(vkCommandBuffer,
+                                         viewportState->viewportCount, viewportState->viewports);
+    }
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_SCISSOR,
+                         dynamicState->scissorCount == viewportState->scissorCount &&
+                         memcmp(dynamicState->scissors, viewportState->scissors,
+                                sizeof(VkRect2D) * viewportState->scissorCount) == 0)) {
+        dynamicState->scissorCount = viewportState->scissorCount;
+        memcpy(dynamicState->scissors, viewportState->scissors,
+               sizeof(VkRect2D) * viewportState->scissorCount);
+        vki.vkCmdSetScissorWithCountEXT(vkCommandBuffer,
+                                        viewportState->scissorCount, viewportState->scissors);
+    }
+}
+
+static void flushRasterState(
+    GrCmdBuffer* grCmdBuffer,
+    const GrRasterStateObject* rasterState)
+{
+    VkCommandBuffer vkCommandBuffer = grCmdBuffer->commandBuffer;
+    DynamicState* dynamicState = &grCmdBuffer->dynamicState;
+
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_CULL_MODE,
+                         dynamicState->cullMode == rasterState->cullMode)) {
+        dynamicState->cullMode = rasterState->cullMode;
+        vki.vkCmdSetCullModeEXT(vkCommandBuffer, rasterState->cullMode);
+    }
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_FRONT_FACE,
+                         dynamicState->frontFace == rasterState->frontFace)) {
+        dynamicState->frontFace = rasterState->frontFace;
+        vki.vkCmdSetFrontFaceEXT(vkCommandBuffer, rasterState->frontFace);
+    }
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_DEPTH_BIAS,
+                         dynamicState->depthBiasConstantFactor ==
+                         rasterState->depthBiasConstantFactor &&
+                         dynamicState->depthBiasClamp == rasterState->depthBiasClamp &&
+                         dynamicState->depthBiasSlopeFactor == rasterState->depthBiasSlopeFactor)) {
+        dynamicState->depthBiasConstantFactor = rasterState->depthBiasConstantFactor;
+        dynamicState->depthBiasClamp = rasterState->depthBiasClamp;
+        dynamicState->depthBiasSlopeFactor = rasterState->depthBiasSlopeFactor;
+        vki.vkCmdSetDepthBias(vkCommandBuffer, rasterState->depthBiasConstantFactor,
+                              rasterState->depthBiasClamp, rasterState->depthBiasSlopeFactor);
+    }
+}
+
+static void flushStencilFaceState(
+    GrCmdBuffer* grCmdBuffer,
+    VkStencilFaceFlags faceMask,
+    VkStencilOpState* shadow,
+    const VkStencilOpState* stencilOpState)
+{
+    VkCommandBuffer vkCommandBuffer = grCmdBuffer->commandBuffer;
+    bool isFront = faceMask == VK_STENCIL_FACE_FRONT_BIT;
+
+    if (testDynamicState(grCmdBuffer,
+                         isFront ? DYNAMIC_STATE_STENCIL_OP_FRONT : DYNAMIC_STATE_STENCIL_OP_BACK,
+                         shadow->failOp == stencilOpState->failOp &&
+                         shadow->passOp == stencilOpState->passOp &&
+                         shadow->depthFailOp == stencilOpState->depthFailOp &&
+                         shadow->compareOp == stencilOpState->compareOp)) {
+        shadow->failOp = stencilOpState->failOp;
+        shadow->passOp = stencilOpState->passOp;
+        shadow->depthFailOp = stencilOpState->depthFailOp;
+        shadow->compareOp = stencilOpState->compareOp;
+        vki.vkCmdSetStencilOpEXT(vkCommandBuffer, faceMask,
+                                 stencilOpState->failOp,
+                                 stencilOpState->passOp,
+                                 stencilOpState->depthFailOp,
+                                 stencilOpState->compareOp);
+    }
+    if (testDynamicState(grCmdBuffer,
+                         isFront ? DYNAMIC_STATE_STENCIL_COMPARE_MASK_FRONT :
+                                   DYNAMIC_STATE_STENCIL_COMPARE_MASK_BACK,
+                         shadow->compareMask == stencilOpState->compareMask)) {
+        shadow->compareMask = stencilOpState->compareMask;
+        vki.vkCmdSetStencilCompareMask(vkCommandBuffer, faceMask, stencilOpState->compareMask);
+    }
+    if (testDynamicState(grCmdBuffer,
+                         isFront ? DYNAMIC_STATE_STENCIL_WRITE_MASK_FRONT :
+                                   DYNAMIC_STATE_STENCIL_WRITE_MASK_BACK,
+                         shadow->writeMask == stencilOpState->writeMask)) {
+        shadow->writeMask = stencilOpState->writeMask;
+        vki.vkCmdSetStencilWriteMask(vkCommandBuffer, faceMask, stencilOpState->writeMask);
+    }
+    if (testDynamicState(grCmdBuffer,
+                         isFront ? DYNAMIC_STATE_STENCIL_REFERENCE_FRONT :
+                                   DYNAMIC_STATE_STENCIL_REFERENCE_BACK,
+                         shadow->reference == stencilOpState->reference)) {
+        shadow->reference = stencilOpState->reference;
+        vki.vkCmdSetStencilReference(vkCommandBuffer, faceMask, stencilOpState->reference);
+    }
+}
+
+static void flushDepthStencilState(
+    GrCmdBuffer* grCmdBuffer,
+    const GrDepthStencilStateObject* depthStencilState)
+{
+    VkCommandBuffer vkCommandBuffer = grCmdBuffer->commandBuffer;
+    DynamicState* dynamicState = &grCmdBuffer->dynamicState;
+
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                         dynamicState->depthTestEnable == depthStencilState->depthTestEnable)) {
+        dynamicState->depthTestEnable = depthStencilState->depthTestEnable;
+        vki.vkCmdSetDepthTestEnableEXT(vkCommandBuffer, depthStencilState->depthTestEnable);
+    }
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+                         dynamicState->depthWriteEnable == depthStencilState->depthWriteEnable)) {
+        dynamicState->depthWriteEnable = depthStencilState->depthWriteEnable;
+        vki.vkCmdSetDepthWriteEnableEXT(vkCommandBuffer, depthStencilState->depthWriteEnable);
+    }
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_DEPTH_COMPARE_OP,
+                         dynamicState->depthCompareOp == depthStencilState->depthCompareOp)) {
+        dynamicState->depthCompareOp = depthStencilState->depthCompareOp;
+        vki.vkCmdSetDepthCompareOpEXT(vkCommandBuffer, depthStencilState->depthCompareOp);
+    }
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE,
+                         dynamicState->depthBoundsTestEnable ==
+                         depthStencilState->depthBoundsTestEnable)) {
+        dynamicState->depthBoundsTestEnable = depthStencilState->depthBoundsTestEnable;
+        vki.vkCmdSetDepthBoundsTestEnableEXT(vkCommandBuffer,
+                                             depthStencilState->depthBoundsTestEnable);
+    }
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_STENCIL_TEST_ENABLE,
+                         dynamicState->stencilTestEnable == depthStencilState->stencilTestEnable)) {
+        dynamicState->stencilTestEnable = depthStencilState->stencilTestEnable;
+        vki.vkCmdSetStencilTestEnableEXT(vkCommandBuffer, depthStencilState->stencilTestEnable);
+    }
+
+    flushStencilFaceState(grCmdBuffer, VK_STENCIL_FACE_FRONT_BIT,
+                          &dynamicState->front, &depthStencilState->front);
+    flushStencilFaceState(grCmdBuffer, VK_STENCIL_FACE_BACK_BIT,
+                          &dynamicState->back, &depthStencilState->back);
+
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_DEPTH_BOUNDS,
+                         dynamicState->minDepthBounds == depthStencilState->minDepthBounds &&
+                         dynamicState->maxDepthBounds == depthStencilState->maxDepthBounds)) {
+        dynamicState->minDepthBounds = depthStencilState->minDepthBounds;
+        dynamicState->maxDepthBounds = depthStencilState->maxDepthBounds;
+        vki.vkCmdSetDepthBounds(vkCommandBuffer,
+                                depthStencilState->minDepthBounds,
+                                depthStencilState->maxDepthBounds);
+    }
+}
+
+static void flushColorBlendState(
+    GrCmdBuffer* grCmdBuffer,
+    const GrColorBlendStateObject* colorBlendState)
+{
+    DynamicState* dynamicState = &grCmdBuffer->dynamicState;
+
+    if (testDynamicState(grCmdBuffer, DYNAMIC_STATE_BLEND_CONSTANTS,
+                         memcmp(dynamicState->blendConstants, colorBlendState->blendConstants,
+                                sizeof(dynamicState->blendConstants)) == 0)) {
+        memcpy(dynamicState->blendConstants, colorBlendState->blendConstants,
+               sizeof(dynamicState->blendConstants));
+        vki.vkCmdSetBlendConstants(grCmdBuffer->commandBuffer, colorBlendState->blendConstants);
+    }
+}
+
+// Emits the dynamic state of the bound state objects that differs from what was last emitted
+static void flushDynamicState(
+    GrCmdBuffer* grCmdBuffer)
+{
+    uint32_t dirtyStateFlags = grCmdBuffer->dirtyStateFlags;
+
+    if ((dirtyStateFlags & DIRTY_STATE_VIEWPORT) && grCmdBuffer->grViewportState != NULL) {
+        flushViewportState(grCmdBuffer, grCmdBuffer->grViewportState);
+    }
+    if ((dirtyStateFlags & DIRTY_STATE_RASTER) && grCmdBuffer->grRasterState != NULL) {
+        flushRasterState(grCmdBuffer, grCmdBuffer->grRasterState);
+    }
+    if ((dirtyStateFlags & DIRTY_STATE_DEPTH_STENCIL) && grCmdBuffer->grDepthStencilState != NULL) {
+        flushDepthStencilState(grCmdBuffer, grCmdBuffer->grDepthStencilState);
+    }
+    if ((dirtyStateFlags & DIRTY_STATE_COLOR_BLEND) && grCmdBuffer->grColorBlendState != NULL) {
+        flushColorBlendState(grCmdBuffer, grCmdBuffer->grColorBlendState);
+    }
+
+    grCmdBuffer->dirtyStateFlags &= ~DIRTY_STATE_DYNAMIC_MASK;
+}
+
+// Returns false if no render pass could be begun with the bound targets
+static bool beginRenderPass(
+    GrCmdBuffer* grCmdBuffer,
+    const AttachmentFormats* formats,
+    const AttachmentOps* ops,
+    uint32_t clearValueCount,
+    const VkClearValue* clearValues)
+{
+    VkExtent2D extent;
+
+    // Framebuffers only depend on render pass compatibility, not on the attachment ops
+    VkRenderPass renderPass = getCachedVkRenderPass(grCmdBuffer->grDevice->renderPassCache,
+                                                    formats, ops);
+    VkFramebuffer framebuffer =
+        getVkFramebuffer(grCmdBuffer->grDevice, renderPass,
+                         grCmdBuffer->colorTargetCount, grCmdBuffer->colorTargets,
+                         grCmdBuffer->hasDepthTarget ? &grCmdBuffer->depthTarget : NULL,
+                         &extent);
+    if (renderPass == VK_NULL_HANDLE || framebuffer == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    const VkRenderPassBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = renderPass,
+        .framebuffer = framebuffer,
+        .renderArea = (VkRect2D) {
+            .offset = { 0, 0 },
+            .extent = extent,
+        },
+        .clearValueCount = clearValueCount,
+        .pClearValues = clearValues,
+    };
+
+    grCmdBuffer->renderPassExtent = extent;
+    vki.vkCmdBeginRenderPass(grCmdBuffer->commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    return true;
+}
+
+static void endRenderPass(
+    GrCmdBuffer* grCmdBuffer)
+{
+    if (grCmdBuffer->hasActiveRenderPass) {
+        vki.vkCmdEndRenderPass(grCmdBuffer->commandBuffer);
+        grCmdBuffer->hasActiveRenderPass = false;
+    }
+}
+
+// Looks up the image among the attachments of the active render pass, returns false if it isn't
+// one or if it's larger than the render area. The depth-stencil attachment has no color index.
+static bool getActiveAttachment(
+    const GrCmdBuffer* grCmdBuffer,
+    const GrImage* grImage,
+    uint32_t* pColorAttachment)
+{
+    const VkExtent2D* renderPassExtent = &grCmdBuffer->renderPassExtent;
+    uint32_t colorAttachment = 0;
+
+    // Bound targets only match the active render pass until they get dirty
+    if (!grCmdBuffer->hasActiveRenderPass ||
+        (grCmdBuffer->dirtyStateFlags & DIRTY_STATE_TARGETS) != 0) {
+        return false;
+    }
+
+    for (int i = 0; i < grCmdBuffer->colorTargetCount; i++) {
+        const GrColorTargetView* grColorTargetView =
+            (GrColorTargetView*)grCmdBuffer->colorTargets[i].view;
+
+        if (grColorTargetView == NULL) {
+            continue;
+        } else if (grColorTargetView->grImage == grImage) {
+            *pColorAttachment = colorAttachment;
+            return grColorTargetView->extent.width == renderPassExtent->width &&
+                   grColorTargetView->extent.height == renderPassExtent->height;
+        }
+
+        colorAttachment++;
+    }
+
+    if (grCmdBuffer->hasDepthTarget && grCmdBuffer->depthTarget.view != GR_NULL_HANDLE) {
+        const GrDepthStencilView* grDepthStencilView =
+            (GrDepthStencilView*)grCmdBuffer->depthTarget.view;
+
+        if (grDepthStencilView->grImage == grImage) {
+            *pColorAttachment = VK_ATTACHMENT_UNUSED;
+            return grDepthStencilView->extent.width == renderPassExtent->width &&
+                   grDepthStencilView->extent.height == renderPassExtent->height;
+        }
+    }
+
+    return false;
+}
+
+static void pushDynamicMemoryView(
+    GrCmdBuffer* grCmdBuffer,
+    VkPipelineBindPoint bindPoint,
+    const GrPipeline* grPipeline,
+    uint32_t setIndex,
+    const VkDescriptorBufferInfo* bufferInfo)
+{
+    const VkWriteDescriptorSet writeDescriptorSet = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstSet = VK_NULL_HANDLE, // Ignored
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pImageInfo = NULL,
+        .pBufferInfo = bufferInfo,
+        .pTexelBufferView = NULL,
+    };
+
+    vki.vkCmdPushDescriptorSetKHR(grCmdBuffer->commandBuffer, bindPoint,
+                                  grPipeline->pipelineLayout, setIndex, 1, &writeDescriptorSet);
+    grCmdBuffer->stats.bindCallCount++;
+}
+
+static void initCmdBufferResources(
+    GrCmdBuffer* grCmdBuffer,
+    const CmdEntry* entry)
+{
+    GrPipeline* grPipeline = grCmdBuffer->grPipeline;
+    VkPipelineBindPoint bindPoint = getVkPipelineBindPoint(GR_PIPELINE_BIND_POINT_GRAPHICS);
+    uint32_t dirtyStateFlags = grCmdBuffer->dirtyStateFlags;
+
+    if (dirtyStateFlags & DIRTY_STATE_PIPELINE) {
+        vki.vkCmdBindPipeline(grCmdBuffer->commandBuffer, bindPoint, grPipeline->pipeline);
+        grCmdBuffer->stats.bindCallCount++;
+
+        // Each pipeline has its own layout, descriptor sets have to be bound again
+        dirtyStateFlags |= DIRTY_STATE_DESCRIPTOR_SET | DIRTY_STATE_DYNAMIC_MEMORY_VIEW;
+
+        // Keep the active render pass if it's compatible with the new pipeline
+        if (memcmp(&grCmdBuffer->renderPassFormats, &grPipeline->attachmentFormats,
+                   sizeof(AttachmentFormats)) != 0) {
+            dirtyStateFlags |= DIRTY_STATE_TARGETS;
+        }
+    }
+
+    if (dirtyStateFlags & DIRTY_STATE_DESCRIPTOR_SET) {
+        printf("%s: HACK only one descriptor bound\n", __func__);
+        vki.vkCmdBindDescriptorSets(grCmdBuffer->commandBuffer, bindPoint,
+                                    grPipeline->pipelineLayout, 0, 1,
+                                    grCmdBuffer->grDescriptorSet->descriptorSets, 0, NULL);
+        grCmdBuffer->stats.bindCallCount++;
+    }
+
+    if ((dirtyStateFlags & DIRTY_STATE_DYNAMIC_MEMORY_VIEW) && grPipeline->hasDynamicMemoryView &&
+        grCmdBuffer->dynamicMemoryView.buffer != VK_NULL_HANDLE) {
+        pushDynamicMemoryView(grCmdBuffer, bindPoint, grPipeline, DYNAMIC_MEMORY_VIEW_SET_INDEX,
+                              &grCmdBuffer->dynamicMemoryView);
+    }
+
+    if (dirtyStateFlags & DIRTY_STATE_INDEX_DATA) {
+        vki.vkCmdBindIndexBuffer(grCmdBuffer->commandBuffer,
+                                 grCmdBuffer->indexGrGpuMemory->buffer,
+                                 grCmdBuffer->indexOffset, grCmdBuffer->indexType);
+        grCmdBuffer->stats.bindCallCount++;
+    }
+
+    if ((dirtyStateFlags & DIRTY_STATE_TARGETS) || !grCmdBuffer->hasActiveRenderPass) {
+        AttachmentOps ops;
+        VkClearValue clearValues[GR_MAX_COLOR_TARGETS + 1];
+
+        uint32_t attachmentCount = getAttachmentOps(grCmdBuffer, entry, &ops, clearValues);
+
+        endRenderPass(grCmdBuffer);
+        if (beginRenderPass(grCmdBuffer, &grPipeline->attachmentFormats, &ops,
+                            attachmentCount, clearValues)) {
+            grCmdBuffer->hasActiveRenderPass = true;
+            grCmdBuffer->renderPassFormats = grPipeline->attachmentFormats;
+            grCmdBuffer->stats.renderPassBeginCount++;
+        }
+    }
+
+    grCmdBuffer->dirtyStateFlags &= ~DIRTY_STATE_RESOURCE_MASK;
+}
+
+// Returns false if the draw has to be skipped, as it can't be recorded outside of a render pass
+static bool prepareDraw(
+    GrCmdBuffer* grCmdBuffer,
+    const CmdEntry* entry)
+{
+    if (grCmdBuffer->dirtyStateFlags & DIRTY_STATE_DYNAMIC_MASK) {
+        flushDynamicState(grCmdBuffer);
+    }
+    if ((grCmdBuffer->dirtyStateFlags & DIRTY_STATE_RESOURCE_MASK) ||
+        !grCmdBuffer->hasActiveRenderPass) {
+        initCmdBufferResources(grCmdBuffer, entry);
+    }
+    if (!grCmdBuffer->hasActiveRenderPass) {
+        return false;
+    }
+
+    grCmdBuffer->stats.drawCallCount++;
+    return true;
+}
+
+// The compute state is tracked separately, dispatching leaves the graphics state untouched
+static void prepareDispatch(
+    GrCmdBuffer* grCmdBuffer)
+{
+    GrPipeline* grPipeline = grCmdBuffer->computeGrPipeline;
+    VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    uint32_t dirtyStateFlags = grCmdBuffer->computeDirtyStateFlags;
+
+    // Dispatches can't be recorded within a render pass, the next draw begins a new one
+    endRenderPass(grCmdBuffer);
+
+    if (dirtyStateFlags & DIRTY_STATE_PIPELINE) {
+        vki.vkCmdBindPipeline(grCmdBuffer->commandBuffer, bindPoint, grPipeline->pipeline);
+        grCmdBuffer->stats.bindCallCount++;
+
+        // Each pipeline has its own layout, descriptor sets have to be bound again
+        dirtyStateFlags |= DIRTY_STATE_DESCRIPTOR_SET | DIRTY_STATE_DYNAMIC_MEMORY_VIEW;
+    }
+
+    if ((dirtyStateFlags & DIRTY_STATE_DESCRIPTOR_SET) &&
+        grCmdBuffer->computeGrDescriptorSet != NULL) {
+        GrDescriptorSet* grDescriptorSet = grCmdBuffer->computeGrDescriptorSet;
+
+        vki.vkCmdBindDescriptorSets(grCmdBuffer->commandBuffer, bindPoint,
+                                    grPipeline->pipelineLayout, 0, 1,
+                                    &grDescriptorSet->descriptorSets[COMPUTE_STAGE_INDEX],
+                                    0, NULL);
+        grCmdBuffer->stats.bindCallCount++;
+    }
+
+    if ((dirtyStateFlags & DIRTY_STATE_DYNAMIC_MEMORY_VIEW) && grPipeline->hasDynamicMemoryView &&
+        grCmdBuffer->computeDynamicMemoryView.buffer != VK_NULL_HANDLE) {
+        pushDynamicMemoryView(grCmdBuffer, bindPoint, grPipeline,
+                              COMPUTE_DYNAMIC_MEMORY_VIEW_SET_INDEX,
+                              &grCmdBuffer->computeDynamicMemoryView);
+    }
+
+    grCmdBuffer->computeDirtyStateFlags = 0;
+    grCmdBuffer->stats.dispatchCallCount++;
+}
+
+static void lowerBindStateObject(
+    GrCmdBuffer* grCmdBuffer,
+    GR_STATE_BIND_POINT bindPoint,
+    GrObject* state)
+{
+    switch (bindPoint) {
+    case GR_STATE_BIND_VIEWPORT:
+        grCmdBuffer->grViewportState = (GrViewportStateObject*)state;
+        grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_VIEWPORT;
+        break;
+    case GR_STATE_BIND_RASTER:
+        grCmdBuffer->grRasterState = (GrRasterStateObject*)state;
+        grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_RASTER;
+        break;
+    case GR_STATE_BIND_DEPTH_STENCIL:
+        grCmdBuffer->grDepthStencilState = (GrDepthStencilStateObject*)state;
+        grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_DEPTH_STENCIL;
+        break;
+    case GR_STATE_BIND_COLOR_BLEND:
+        grCmdBuffer->grColorBlendState = (GrColorBlendStateObject*)state;
+        grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_COLOR_BLEND;
+        break;
+    case GR_STATE_BIND_MSAA:
+        // TODO
+        break;
+    }
+}
+
+static void lowerBindTargets(
+    GrCmdBuffer* grCmdBuffer,
+    uint32_t colorTargetCount,
+    const GR_COLOR_TARGET_BIND_INFO* pColorTargets,
+    const GR_DEPTH_STENCIL_BIND_INFO* pDepthTarget)
+{
+    // Rebinding the same targets doesn't require a new render pass
+    if (grCmdBuffer->colorTargetCount == colorTargetCount &&
+        memcmp(grCmdBuffer->colorTargets, pColorTargets,
+               sizeof(GR_COLOR_TARGET_BIND_INFO) * colorTargetCount) == 0 &&
+        grCmdBuffer->hasDepthTarget == (pDepthTarget != NULL) &&
+        (pDepthTarget == NULL ||
+         memcmp(&grCmdBuffer->depthTarget, pDepthTarget, sizeof(GR_DEPTH_STENCIL_BIND_INFO)) == 0)) {
+        return;
+    }
+
+    memcpy(grCmdBuffer->colorTargets, pColorTargets,
+           sizeof(GR_COLOR_TARGET_BIND_INFO) * colorTargetCount);
+    grCmdBuffer->colorTargetCount = colorTargetCount;
+
+    if (pDepthTarget == NULL) {
+        grCmdBuffer->hasDepthTarget = false;
+    } else {
+        memcpy(&grCmdBuffer->depthTarget, pDepthTarget, sizeof(GR_DEPTH_STENCIL_BIND_INFO));
+        grCmdBuffer->hasDepthTarget = true;
+    }
+
+    grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_TARGETS;
+}
+
+static void deferClearImage(
+    GrCmdBuffer* grCmdBuffer,
+    const CmdEntry* entry)
+{
+    VkImageAspectFlags aspectMask = 0;
+
+    for (int i = 0; i < entry->clearImage.rangeCount; i++) {
+        aspectMask |= entry->clearImage.ranges[i].aspectMask;
+    }
+
+    addPendingLoadOp(grCmdBuffer, entry->clearImage.grImage->image, aspectMask,
+                     VK_ATTACHMENT_LOAD_OP_CLEAR, &entry->clearImage.clearValue);
+
+    // Begin a new render pass to apply the clear
+    grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_TARGETS;
+}
+
+// Clears a target of the active render pass without ending it
+static void lowerAttachmentClear(
+    GrCmdBuffer* grCmdBuffer,
+    const CmdEntry* entry,
+    uint32_t colorAttachment)
+{
+    VkImageAspectFlags aspectMask = 0;
+
+    for (int i = 0; i < entry->clearImage.rangeCount; i++) {
+        aspectMask |= entry->clearImage.ranges[i].aspectMask;
+    }
+
+    const VkClearAttachment clearAttachment = {
+        .aspectMask = aspectMask,
+        .colorAttachment = colorAttachment,
+        .clearValue = entry->clearImage.clearValue,
+    };
+
+    const VkClearRect clearRect = {
+        .rect = {
+            .offset = { 0, 0 },
+            .extent = grCmdBuffer->renderPassExtent,
+        },
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+
+    removePendingLoadOps(grCmdBuffer, entry->clearImage.grImage->image);
+    vki.vkCmdClearAttachments(grCmdBuffer->commandBuffer, 1, &clearAttachment, 1, &clearRect);
+}
+
+static void lowerBarrier(
+    GrCmdBuffer* grCmdBuffer,
+    const CmdEntry* entry)
+{
+    uint32_t colorAttachment;
+
+    // The target stays in its attachment layout if the clear happens within the render pass
+    if (entry->barrier.clearedTarget != NULL &&
+        getActiveAttachment(grCmdBuffer, entry->barrier.clearedTarget, &colorAttachment)) {
+        return;
+    }
+
+    for (int i = 0; i < entry->barrier.imageBarrierCount; i++) {
+        const VkImageMemoryBarrier* barrier = &entry->barrier.imageBarriers[i];
+
+        // Contents coming from an uninitialized or discarded state don't need to be loaded
+        if (barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
+            isAttachmentLayout(barrier->newLayout)) {
+            addPendingLoadOp(grCmdBuffer, barrier->image, barrier->subresourceRange.aspectMask,
+                             VK_ATTACHMENT_LOAD_OP_DONT_CARE, NULL);
+        } else {
+            removePendingLoadOps(grCmdBuffer, barrier->image);
+        }
+    }
+
+    endRenderPass(grCmdBuffer);
+    vki.vkCmdPipelineBarrier(grCmdBuffer->commandBuffer,
+                             entry->barrier.srcStageMask, entry->barrier.dstStageMask, 0,
+                             0, NULL,
+                             entry->barrier.bufferBarrierCount, entry->barrier.bufferBarriers,
+                             entry->barrier.imageBarrierCount, entry->barrier.imageBarriers);
+    grCmdBuffer->stats.barrierCallCount++;
+}
+
+static void lowerCmdEntry(
+    GrCmdBuffer* grCmdBuffer,
+    const CmdEntry* entry)
+{
+    VkCommandBuffer vkCommandBuffer = grCmdBuffer->commandBuffer;
+
+    switch (entry->type) {
+    case CMD_NOP:
+        break;
+    case CMD_BIND_PIPELINE:
+        if (entry->bindPipeline.bindPoint == GR_PIPELINE_BIND_POINT_COMPUTE &&
+            grCmdBuffer->computeGrPipeline != entry->bindPipeline.grPipeline) {
+            grCmdBuffer->computeGrPipeline = entry->bindPipeline.grPipeline;
+            grCmdBuffer->computeDirtyStateFlags |= DIRTY_STATE_PIPELINE;
+        } else if (entry->bindPipeline.bindPoint == GR_PIPELINE_BIND_POINT_GRAPHICS &&
+                   grCmdBuffer->grPipeline != entry->bindPipeline.grPipeline) {
+            grCmdBuffer->grPipeline = entry->bindPipeline.grPipeline;
+            grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_PIPELINE;
+        } else {
+            grCmdBuffer->stats.skippedBindCount++;
+        }
+        break;
+    case CMD_BIND_STATE_OBJECT:
+        lowerBindStateObject(grCmdBuffer, entry->bindStateObject.bindPoint,
+                             entry->bindStateObject.state);
+        break;
+    case CMD_BIND_DESCRIPTOR_SET:
+        if (entry->bindDescriptorSet.bindPoint == GR_PIPELINE_BIND_POINT_COMPUTE &&
+            grCmdBuffer->computeGrDescriptorSet != entry->bindDescriptorSet.grDescriptorSet) {
+            grCmdBuffer->computeGrDescriptorSet = entry->bindDescriptorSet.grDescriptorSet;
+            grCmdBuffer->computeDirtyStateFlags |= DIRTY_STATE_DESCRIPTOR_SET;
+        } else if (entry->bindDescriptorSet.bindPoint == GR_PIPELINE_BIND_POINT_GRAPHICS &&
+                   grCmdBuffer->grDescriptorSet != entry->bindDescriptorSet.grDescriptorSet) {
+            grCmdBuffer->grDescriptorSet = entry->bindDescriptorSet.grDescriptorSet;
+            grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_DESCRIPTOR_SET;
+        } else {
+            grCmdBuffer->stats.skippedBindCount++;
+        }
+        break;
+    case CMD_BIND_TARGETS:
+        lowerBindTargets(grCmdBuffer, entry->bindTargets.colorTargetCount,
+                         entry->bindTargets.colorTargets, entry->bindTargets.depthTarget);
+        break;
+    case CMD_BIND_INDEX_DATA:
+        if (grCmdBuffer->indexGrGpuMemory != entry->bindIndexData.grGpuMemory ||
+            grCmdBuffer->indexOffset != entry->bindIndexData.offset ||
+            grCmdBuffer->indexType != entry->bindIndexData.indexType) {
+            grCmdBuffer->indexGrGpuMemory = entry->bindIndexData.grGpuMemory;
+            grCmdBuffer->indexOffset = entry->bindIndexData.offset;
+            grCmdBuffer->indexType = entry->bindIndexData.indexType;
+            grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_INDEX_DATA;
+        } else {
+            grCmdBuffer->stats.skippedBindCount++;
+        }
+        break;
+    case CMD_BIND_DYNAMIC_MEMORY_VIEW:
+        if (entry->bindDynamicMemoryView.bindPoint == GR_PIPELINE_BIND_POINT_COMPUTE &&
+            memcmp(&grCmdBuffer->computeDynamicMemoryView,
+                   &entry->bindDynamicMemoryView.bufferInfo,
+                   sizeof(VkDescriptorBufferInfo)) != 0) {
+            grCmdBuffer->computeDynamicMemoryView = entry->bindDynamicMemoryView.bufferInfo;
+            grCmdBuffer->computeDirtyStateFlags |= DIRTY_STATE_DYNAMIC_MEMORY_VIEW;
+        } else if (entry->bindDynamicMemoryView.bindPoint == GR_PIPELINE_BIND_POINT_GRAPHICS &&
+                   memcmp(&grCmdBuffer->dynamicMemoryView,
+                          &entry->bindDynamicMemoryView.bufferInfo,
+                          sizeof(VkDescriptorBufferInfo)) != 0) {
+            grCmdBuffer->dynamicMemoryView = entry->bindDynamicMemoryView.bufferInfo;
+            grCmdBuffer->dirtyStateFlags |= DIRTY_STATE_DYNAMIC_MEMORY_VIEW;
+        } else {
+            grCmdBuffer->stats.skippedBindCount++;
+        }
+        break;
+    case CMD_BARRIER:
+        lowerBarrier(grCmdBuffer, entry);
+        break;
+    case CMD_DRAW:
+        if (prepareDraw(grCmdBuffer, entry)) {
+            vki.vkCmdDraw(vkCommandBuffer,
+                          entry->draw.vertexCount, entry->draw.instanceCount,
+                          entry->draw.firstVertex, entry->draw.firstInstance);
+        }
+        break;
+    case CMD_DRAW_INDEXED:
+        if (prepareDraw(grCmdBuffer, entry)) {
+            vki.vkCmdDrawIndexed(vkCommandBuffer,
+                                 entry->drawIndexed.indexCount, entry->drawIndexed.instanceCount,
+                                 entry->drawIndexed.firstIndex, entry->drawIndexed.vertexOffset,
+                                 entry->drawIndexed.firstInstance);
+        }
+        break;
+    case CMD_DRAW_INDIRECT:
+        if (prepareDraw(grCmdBuffer, entry)) {
+            vki.vkCmdDrawIndirect(vkCommandBuffer, entry->drawIndirect.grGpuMemory->buffer,
+                                  entry->drawIndirect.offset, entry->drawIndirect.drawCount,
+                                  sizeof(GR_DRAW_INDIRECT_ARG));
+        }
+        break;
+    case CMD_DRAW_INDEXED_INDIRECT:
+        if (prepareDraw(grCmdBuffer, entry)) {
+            vki.vkCmdDrawIndexedIndirect(vkCommandBuffer, entry->drawIndirect.grGpuMemory->buffer,
+                                         entry->drawIndirect.offset, entry->drawIndirect.drawCount,
+                                         sizeof(GR_DRAW_INDEXED_INDIRECT_ARG));
+        }
+        break;
+    case CMD_DISPATCH:
+        prepareDispatch(grCmdBuffer);
+        vki.vkCmdDispatch(vkCommandBuffer,
+                          entry->dispatch.x, entry->dispatch.y, entry->dispatch.z);
+        break;
+    case CMD_DISPATCH_INDIRECT:
+        prepareDispatch(grCmdBuffer);
+        vki.vkCmdDispatchIndirect(vkCommandBuffer, entry->dispatchIndirect.grGpuMemory->buffer,
+                                  entry->dispatchIndirect.offset);
+        break;
+    case CMD_COPY_BUFFER:
+        endRenderPass(grCmdBuffer);
+        vki.vkCmdCopyBuffer(vkCommandBuffer, entry->copy.srcBuffer, entry->copy.dstBuffer,
+                            entry->copy.regionCount, entry->copy.bufferRegions);
+        break;
+    case CMD_COPY_IMAGE:
+        removePendingLoadOps(grCmdBuffer, entry->copy.dstImage->image);
+        endRenderPass(grCmdBuffer);
+        vki.vkCmdCopyImage(vkCommandBuffer, entry->copy.srcImage->image, entry->copy.srcLayout,
+                           entry->copy.dstImage->image, entry->copy.dstLayout,
+                           entry->copy.regionCount, entry->copy.imageRegions);
+        break;
+    case CMD_COPY_BUFFER_TO_IMAGE:
+        removePendingLoadOps(grCmdBuffer, entry->copy.dstImage->image);
+        endRenderPass(grCmdBuffer);
+        vki.vkCmdCopyBufferToImage(vkCommandBuffer, entry->copy.srcBuffer,
+                                   entry->copy.dstImage->image, entry->copy.dstLayout,
+                                   entry->copy.regionCount, entry->copy.bufferImageRegions);
+        break;
+    case CMD_COPY_IMAGE_TO_BUFFER:
+        endRenderPass(grCmdBuffer);
+        vki.vkCmdCopyImageToBuffer(vkCommandBuffer, entry->copy.srcImage->image,
+                                   entry->copy.srcLayout, entry->copy.dstBuffer,
+                                   entry->copy.regionCount, entry->copy.bufferImageRegions);
+        break;
+    case CMD_RESOLVE_IMAGE:
+        removePendingLoadOps(grCmdBuffer, entry->copy.dstImage->image);
+        endRenderPass(grCmdBuffer);
+        if (entry->copy.srcImage->samples == VK_SAMPLE_COUNT_1_BIT) {
+            // Nothing to resolve, VkImageResolve has the same layout as VkImageCopy
+            vki.vkCmdCopyImage(vkCommandBuffer, entry->copy.srcImage->image,
+                               entry->copy.srcLayout, entry->copy.dstImage->image,
+                               entry->copy.dstLayout, entry->copy.regionCount,
+                               (const VkImageCopy*)entry->copy.resolveRegions);
+        } else {
+            vki.vkCmdResolveImage(vkCommandBuffer, entry->copy.srcImage->image,
+                                  entry->copy.srcLayout, entry->copy.dstImage->image,
+                                  entry->copy.dstLayout, entry->copy.regionCount,
+                                  entry->copy.resolveRegions);
+        }
+        break;
+    case CMD_FILL_BUFFER:
+        endRenderPass(grCmdBuffer);
+        vki.vkCmdFillBuffer(vkCommandBuffer, entry->fillBuffer.dstBuffer,
+                            entry->fillBuffer.offset, entry->fillBuffer.size,
+                            entry->fillBuffer.data);
+        break;
+    case CMD_CLEAR_COLOR_IMAGE:
+    case CMD_CLEAR_DEPTH_STENCIL: {
+        uint32_t colorAttachment;
+
+        if (entry->clearImage.isAttachmentClear &&
+            getActiveAttachment(grCmdBuffer, entry->clearImage.grImage, &colorAttachment)) {
+            lowerAttachmentClear(grCmdBuffer, entry, colorAttachment);
+            break;
+        } else if (entry->clearImage.isFolded) {
+            deferClearImage(grCmdBuffer, entry);
+            break;
+        }
+
+        removePendingLoadOps(grCmdBuffer, entry->clearImage.grImage->image);
+        endRenderPass(grCmdBuffer);
+        if (entry->type == CMD_CLEAR_COLOR_IMAGE) {
+            vki.vkCmdClearColorImage(vkCommandBuffer, entry->clearImage.grImage->image,
+                                     getVkImageLayout(GR_IMAGE_STATE_CLEAR),
+                                     &entry->clearImage.clearValue.color,
+                                     entry->clearImage.rangeCount, entry->clearImage.ranges);
+        } else {
+            vki.vkCmdClearDepthStencilImage(vkCommandBuffer, entry->clearImage.grImage->image,
+                                            getVkImageLayout(GR_IMAGE_STATE_CLEAR),
+                                            &entry->clearImage.clearValue.depthStencil,
+                                            entry->clearImage.rangeCount,
+                                            entry->clearImage.ranges);
+        }
+    }   break;
+    case CMD_DISCARD_IMAGE:
+        // Only used to pick store ops
+        break;
+    }
+}
+
+// Removes state binds that are overridden or never consumed by a draw
+static void removeDeadBinds(
+    GrCmdBuffer* grCmdBuffer)
+{
+    enum {
+        BIND_SLOT_PIPELINE,
+        BIND_SLOT_DESCRIPTOR_SET,
+        BIND_SLOT_TARGETS,
+        BIND_SLOT_INDEX_DATA,
+        BIND_SLOT_DYNAMIC_MEMORY_VIEW,
+        BIND_SLOT_STATE_OBJECT, // One per state bind point
+        BIND_SLOT_COMPUTE_PIPELINE =
+            BIND_SLOT_STATE_OBJECT + GR_STATE_BIND_MSAA - GR_STATE_BIND_VIEWPORT + 1,
+        BIND_SLOT_COMPUTE_DESCRIPTOR_SET,
+        BIND_SLOT_COMPUTE_DYNAMIC_MEMORY_VIEW,
+        BIND_SLOT_COUNT,
+    };
+    CmdEntry* pendingBinds[BIND_SLOT_COUNT] = { NULL };
+
+    for (CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        int slot = -1;
+
+        switch (entry->type) {
+        case CMD_BIND_PIPELINE:
+            slot = entry->bindPipeline.bindPoint == GR_PIPELINE_BIND_POINT_COMPUTE ?
+                   BIND_SLOT_COMPUTE_PIPELINE : BIND_SLOT_PIPELINE;
+            break;
+        case CMD_BIND_DESCRIPTOR_SET:
+            slot = entry->bindDescriptorSet.bindPoint == GR_PIPELINE_BIND_POINT_COMPUTE ?
+                   BIND_SLOT_COMPUTE_DESCRIPTOR_SET : BIND_SLOT_DESCRIPTOR_SET;
+            break;
+        case CMD_BIND_TARGETS:
+            slot = BIND_SLOT_TARGETS;
+            break;
+        case CMD_BIND_INDEX_DATA:
+            slot = BIND_SLOT_INDEX_DATA;
+            break;
+        case CMD_BIND_DYNAMIC_MEMORY_VIEW:
+            slot = entry->bindDynamicMemoryView.bindPoint == GR_PIPELINE_BIND_POINT_COMPUTE ?
+                   BIND_SLOT_COMPUTE_DYNAMIC_MEMORY_VIEW : BIND_SLOT_DYNAMIC_MEMORY_VIEW;
+            break;
+        case CMD_BIND_STATE_OBJECT:
+            if (entry->bindStateObject.bindPoint >= GR_STATE_BIND_VIEWPORT &&
+                entry->bindStateObject.bindPoint <= GR_STATE_BIND_MSAA) {
+                slot = BIND_SLOT_STATE_OBJECT +
+                       entry->bindStateObject.bindPoint - GR_STATE_BIND_VIEWPORT;
+            }
+            break;
+        case CMD_DRAW:
+        case CMD_DRAW_INDEXED:
+        case CMD_DRAW_INDIRECT:
+        case CMD_DRAW_INDEXED_INDIRECT:
+            // Compute binds are kept pending, draws don't consume them
+            memset(pendingBinds, 0, sizeof(CmdEntry*) * BIND_SLOT_COMPUTE_PIPELINE);
+            break;
+        case CMD_DISPATCH:
+        case CMD_DISPATCH_INDIRECT:
+            memset(&pendingBinds[BIND_SLOT_COMPUTE_PIPELINE], 0,
+                   sizeof(CmdEntry*) * (BIND_SLOT_COUNT - BIND_SLOT_COMPUTE_PIPELINE));
+            break;
+        case CMD_NOP:
+        case CMD_BARRIER:
+        case CMD_COPY_BUFFER:
+        case CMD_COPY_IMAGE:
+        case CMD_COPY_BUFFER_TO_IMAGE:
+        case CMD_COPY_IMAGE_TO_BUFFER:
+        case CMD_RESOLVE_IMAGE:
+        case CMD_FILL_BUFFER:
+        case CMD_CLEAR_COLOR_IMAGE:
+        case CMD_CLEAR_DEPTH_STENCIL:
+        case CMD_DISCARD_IMAGE:
+            break;
+        }
+
+        if (slot >= 0) {
+            if (pendingBinds[slot] != NULL) {
+                pendingBinds[slot]->type = CMD_NOP;
+                grCmdBuffer->stats.skippedBindCount++;
+            }
+            pendingBinds[slot] = entry;
+        }
+    }
+
+    for (int i = 0; i < BIND_SLOT_COUNT; i++) {
+        if (pendingBinds[i] != NULL) {
+            pendingBinds[i]->type = CMD_NOP;
+            grCmdBuffer->stats.skippedBindCount++;
+        }
+    }
+}
+
+static bool barriersOverlap(
+    const CmdEntry* entry,
+    const CmdEntry* other)
+{
+    for (int i = 0; i < entry->barrier.imageBarrierCount; i++) {
+        for (int j = 0; j < other->barrier.imageBarrierCount; j++) {
+            if (entry->barrier.imageBarriers[i].image == other->barrier.imageBarriers[j].image) {
+                return true;
+            }
+        }
+    }
+
+    for (int i = 0; i < entry->barrier.bufferBarrierCount; i++) {
+        for (int j = 0; j < other->barrier.bufferBarrierCount; j++) {
+            if (entry->barrier.bufferBarriers[i].buffer == other->barrier.bufferBarriers[j].buffer) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static void mergeBarrierEntries(
+    GrCmdBuffer* grCmdBuffer,
+    CmdEntry* entry,
+    const CmdEntry* other)
+{
+    uint32_t bufferBarrierCount =
+        entry->barrier.bufferBarrierCount + other->barrier.bufferBarrierCount;
+    uint32_t imageBarrierCount =
+        entry->barrier.imageBarrierCount + other->barrier.imageBarrierCount;
+    VkBufferMemoryBarrier* bufferBarriers =
+        allocArena(grCmdBuffer->arena, sizeof(VkBufferMemoryBarrier) * bufferBarrierCount);
+    VkImageMemoryBarrier* imageBarriers =
+        allocArena(grCmdBuffer->arena, sizeof(VkImageMemoryBarrier) * imageBarrierCount);
+
+    memcpy(bufferBarriers, entry->barrier.bufferBarriers,
+           sizeof(VkBufferMemoryBarrier) * entry->barrier.bufferBarrierCount);
+    memcpy(&bufferBarriers[entry->barrier.bufferBarrierCount],
+           other->barrier.bufferBarriers,
+           sizeof(VkBufferMemoryBarrier) * other->barrier.bufferBarrierCount);
+    memcpy(imageBarriers, entry->barrier.imageBarriers,
+           sizeof(VkImageMemoryBarrier) * entry->barrier.imageBarrierCount);
+    memcpy(&imageBarriers[entry->barrier.imageBarrierCount],
+           other->barrier.imageBarriers,
+           sizeof(VkImageMemoryBarrier) * other->barrier.imageBarrierCount);
+
+    entry->barrier.srcStageMask |= other->barrier.srcStageMask;
+    entry->barrier.dstStageMask |= other->barrier.dstStageMask;
+    entry->barrier.bufferBarrierCount = bufferBarrierCount;
+    entry->barrier.bufferBarriers = bufferBarriers;
+    entry->barrier.imageBarrierCount = imageBarrierCount;
+    entry->barrier.imageBarriers = imageBarriers;
+}
+
+// Merges barriers separated only by state binds into a single barrier, as long as they
+// transition different resources
+static void mergeBarriers(
+    GrCmdBuffer* grCmdBuffer)
+{
+    CmdEntry* barrierEntry = NULL;
+
+    for (CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        switch (entry->type) {
+        case CMD_BARRIER:
+            if (barrierEntry == NULL || barriersOverlap(barrierEntry, entry)) {
+                barrierEntry = entry;
+                break;
+            }
+
+            mergeBarrierEntries(grCmdBuffer, barrierEntry, entry);
+            entry->type = CMD_NOP;
+            break;
+        case CMD_NOP:
+        case CMD_BIND_PIPELINE:
+        case CMD_BIND_STATE_OBJECT:
+        case CMD_BIND_DESCRIPTOR_SET:
+        case CMD_BIND_INDEX_DATA:
+        case CMD_BIND_DYNAMIC_MEMORY_VIEW:
+        case CMD_BIND_TARGETS:
+        case CMD_DISCARD_IMAGE:
+            // Barriers can be moved across state binds, they don't execute anything
+            break;
+        case CMD_DRAW:
+        case CMD_DRAW_INDEXED:
+        case CMD_DRAW_INDIRECT:
+        case CMD_DRAW_INDEXED_INDIRECT:
+        case CMD_DISPATCH:
+        case CMD_DISPATCH_INDIRECT:
+        case CMD_COPY_BUFFER:
+        case CMD_COPY_IMAGE:
+        case CMD_COPY_BUFFER_TO_IMAGE:
+        case CMD_COPY_IMAGE_TO_BUFFER:
+        case CMD_RESOLVE_IMAGE:
+        case CMD_FILL_BUFFER:
+        case CMD_CLEAR_COLOR_IMAGE:
+        case CMD_CLEAR_DEPTH_STENCIL:
+            barrierEntry = NULL;
+            break;
+        }
+    }
+}
+
+// Checks if a clear is only followed by binds and transitions to a target state before the image
+// gets drawn to as a target, with a render area covering the whole image
+static bool isClearFoldable(
+    const CmdEntry* clearEntry,
+    const CmdEntry* bindTargetsEntry)
+{
+    const GrImage* grImage = clearEntry->clearImage.grImage;
+
+    // The render pass can only clear the subresource of the view
+    if (grImage->mipLevels != 1 || grImage->arrayLayers != 1) {
+        return false;
+    }
+
+    for (const CmdEntry* entry = clearEntry->next; entry != NULL; entry = entry->next) {
+        switch (entry->type) {
+        case CMD_NOP:
+        case CMD_BIND_PIPELINE:
+        case CMD_BIND_STATE_OBJECT:
+        case CMD_BIND_DESCRIPTOR_SET:
+        case CMD_BIND_INDEX_DATA:
+        case CMD_BIND_DYNAMIC_MEMORY_VIEW:
+        case CMD_FILL_BUFFER:
+            break;
+        case CMD_BIND_TARGETS:
+            bindTargetsEntry = entry;
+            break;
+        case CMD_DISPATCH:
+        case CMD_DISPATCH_INDIRECT:
+            // Shaders may access the image before the draw
+            return false;
+        case CMD_COPY_BUFFER:
+        case CMD_COPY_IMAGE:
+        case CMD_COPY_BUFFER_TO_IMAGE:
+        case CMD_COPY_IMAGE_TO_BUFFER:
+        case CMD_RESOLVE_IMAGE:
+            // The clear would only happen after the copy
+            if (isImageCopied(entry, grImage)) {
+                return false;
+            }
+            break;
+        case CMD_DISCARD_IMAGE:
+            if (entry->discardImage.grImage == grImage) {
+                return false;
+            }
+            break;
+        case CMD_BARRIER:
+            for (int i = 0; i < entry->barrier.imageBarrierCount; i++) {
+                const VkImageMemoryBarrier* barrier = &entry->barrier.imageBarriers[i];
+
+                if (barrier->image == grImage->image && !isAttachmentLayout(barrier->newLayout)) {
+                    return false;
+                }
+            }
+            break;
+        case CMD_CLEAR_COLOR_IMAGE:
+        case CMD_CLEAR_DEPTH_STENCIL:
+            if (entry->clearImage.grImage == grImage) {
+                return false;
+            }
+            break;
+        case CMD_DRAW:
+        case CMD_DRAW_INDEXED:
+        case CMD_DRAW_INDIRECT:
+        case CMD_DRAW_INDEXED_INDIRECT:
+            return isTargetCovered(bindTargetsEntry, grImage);
+        }
+    }
+
+    return false;
+}
+
+// Turns full image clears into render pass load ops when the image is about to be drawn to
+static void foldClears(
+    GrCmdBuffer* grCmdBuffer)
+{
+    const CmdEntry* bindTargetsEntry = NULL;
+
+    for (CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        switch (entry->type) {
+        case CMD_BIND_TARGETS:
+            bindTargetsEntry = entry;
+            break;
+        case CMD_CLEAR_COLOR_IMAGE:
+        case CMD_CLEAR_DEPTH_STENCIL:
+            entry->clearImage.isFolded = isClearFoldable(entry, bindTargetsEntry);
+            break;
+        case CMD_NOP:
+        case CMD_BIND_PIPELINE:
+        case CMD_BIND_STATE_OBJECT:
+        case CMD_BIND_DESCRIPTOR_SET:
+        case CMD_BIND_INDEX_DATA:
+        case CMD_BIND_DYNAMIC_MEMORY_VIEW:
+        case CMD_BARRIER:
+        case CMD_DRAW:
+        case CMD_DRAW_INDEXED:
+        case CMD_DRAW_INDIRECT:
+        case CMD_DRAW_INDEXED_INDIRECT:
+        case CMD_DISPATCH:
+        case CMD_DISPATCH_INDIRECT:
+        case CMD_COPY_BUFFER:
+        case CMD_COPY_IMAGE:
+        case CMD_COPY_BUFFER_TO_IMAGE:
+        case CMD_COPY_IMAGE_TO_BUFFER:
+        case CMD_RESOLVE_IMAGE:
+        case CMD_FILL_BUFFER:
+        case CMD_DISCARD_IMAGE:
+            break;
+        }
+    }
+}
+
+// Checks for a barrier made of a single transition of the image between the given layouts
+static bool isClearTransition(
+    const CmdEntry* entry,
+    const GrImage* grImage,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout)
+{
+    if (entry == NULL || entry->type != CMD_BARRIER ||
+        entry->barrier.bufferBarrierCount != 0 || entry->barrier.imageBarrierCount != 1) {
+        return false;
+    }
+
+    const VkImageMemoryBarrier* barrier = &entry->barrier.imageBarriers[0];
+
+    return barrier->image == grImage->image &&
+           barrier->oldLayout == oldLayout &&
+           barrier->newLayout == newLayout;
+}
+
+// Finds clears of a target right between transitions out of and back to its attachment layout.
+// If the target belongs to the active render pass when lowering, the clear is done within it
+// and the transitions are skipped.
+static void findAttachmentClears(
+    GrCmdBuffer* grCmdBuffer)
+{
+    VkImageLayout clearLayout = getVkImageLayout(GR_IMAGE_STATE_CLEAR);
+    CmdEntry* prevEntry = NULL;
+
+    for (CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        if (entry->type == CMD_NOP) {
+            continue;
+        } else if ((entry->type != CMD_CLEAR_COLOR_IMAGE &&
+                    entry->type != CMD_CLEAR_DEPTH_STENCIL) ||
+                   prevEntry == NULL || prevEntry->type != CMD_BARRIER ||
+                   prevEntry->barrier.imageBarrierCount != 1) {
+            prevEntry = entry;
+            continue;
+        }
+
+        GrImage* grImage = entry->clearImage.grImage;
+        VkImageLayout attachmentLayout = prevEntry->barrier.imageBarriers[0].oldLayout;
+        CmdEntry* nextEntry = entry->next;
+
+        while (nextEntry != NULL && nextEntry->type == CMD_NOP) {
+            nextEntry = nextEntry->next;
+        }
+
+        // Attachments only cover a single subresource
+        if (grImage->mipLevels == 1 && grImage->arrayLayers == 1 &&
+            isAttachmentLayout(attachmentLayout) &&
+            isClearTransition(prevEntry, grImage, attachmentLayout, clearLayout) &&
+            isClearTransition(nextEntry, grImage, clearLayout, attachmentLayout)) {
+            prevEntry->barrier.clearedTarget = grImage;
+            nextEntry->barrier.clearedTarget = grImage;
+            entry->clearImage.isAttachmentClear = true;
+        }
+
+        prevEntry = entry;
+    }
+}
+
+static uint32_t getIndirectArgSize(
+    CmdType type)
+{
+    return type == CMD_DRAW_INDEXED_INDIRECT ? sizeof(GR_DRAW_INDEXED_INDIRECT_ARG) :
+                                               sizeof(GR_DRAW_INDIRECT_ARG);
+}
+
+// Merges back-to-back indirect draws reading adjacent argument records into a single multi-draw
+static void mergeIndirectDraws(
+    GrCmdBuffer* grCmdBuffer)
+{
+    uint32_t maxDrawCount = grCmdBuffer->grDevice->maxDrawIndirectCount;
+    CmdEntry* drawEntry = NULL;
+
+    if (maxDrawCount <= 1) {
+        return;
+    }
+
+    for (CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        if (entry->type == CMD_NOP) {
+            continue;
+        } else if (entry->type != CMD_DRAW_INDIRECT && entry->type != CMD_DRAW_INDEXED_INDIRECT) {
+            // Anything else in between could change the state of the draws
+            drawEntry = NULL;
+            continue;
+        }
+
+        if (drawEntry != NULL &&
+            drawEntry->type == entry->type &&
+            drawEntry->drawIndirect.grGpuMemory == entry->drawIndirect.grGpuMemory &&
+            drawEntry->drawIndirect.offset +
+            drawEntry->drawIndirect.drawCount * getIndirectArgSize(entry->type) ==
+            entry->drawIndirect.offset &&
+            drawEntry->drawIndirect.drawCount < maxDrawCount) {
+            if (drawEntry->drawIndirect.drawCount == 1) {
+                grCmdBuffer->stats.mergedIndirectCallCount++;
+                grCmdBuffer->stats.mergedIndirectDrawCount++;
+            }
+
+            drawEntry->drawIndirect.drawCount++;
+            grCmdBuffer->stats.mergedIndirectDrawCount++;
+            entry->type = CMD_NOP;
+        } else {
+            drawEntry = entry;
+        }
+    }
+}
+
+static bool rangesOverlap(
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    VkDeviceSize otherOffset,
+    VkDeviceSize otherSize)
+{
+    return offset < otherOffset + otherSize && otherOffset < offset + size;
+}
+
+static bool imageRegionsOverlap(
+    const VkImageSubresourceLayers* subresource,
+    const VkOffset3D* offset,
+    const VkExtent3D* extent,
+    const VkImageSubresourceLayers* otherSubresource,
+    const VkOffset3D* otherOffset,
+    const VkExtent3D* otherExtent)
+{
+    return (subresource->aspectMask & otherSubresource->aspectMask) != 0 &&
+           subresource->mipLevel == otherSubresource->mipLevel &&
+           rangesOverlap(subresource->baseArrayLayer, subresource->layerCount,
+                         otherSubresource->baseArrayLayer, otherSubresource->layerCount) &&
+           rangesOverlap(offset->x, extent->width, otherOffset->x, otherExtent->width) &&
+           rangesOverlap(offset->y, extent->height, otherOffset->y, otherExtent->height) &&
+           rangesOverlap(offset->z, extent->depth, otherOffset->z, otherExtent->depth);
+}
+
+// Regions of a single copy execute in no particular order, so they can't depend on each other
+static bool copyRegionsOverlap(
+    const CmdEntry* entry,
+    uint32_t regionIdx,
+    const CmdEntry* other,
+    uint32_t otherRegionIdx)
+{
+    if (entry->type == CMD_COPY_BUFFER) {
+        const VkBufferCopy* region = &entry->copy.bufferRegions[regionIdx];
+        const VkBufferCopy* otherRegion = &other->copy.bufferRegions[otherRegionIdx];
+        bool isSameBuffer = entry->copy.srcBuffer == entry->copy.dstBuffer;
+
+        return rangesOverlap(region->dstOffset, region->size,
+                             otherRegion->dstOffset, otherRegion->size) ||
+               (isSameBuffer && rangesOverlap(region->srcOffset, region->size,
+                                              otherRegion->dstOffset, otherRegion->size)) ||
+               (isSameBuffer && rangesOverlap(region->dstOffset, region->size,
+                                              otherRegion->srcOffset, otherRegion->size));
+    } else if (entry->type == CMD_COPY_IMAGE) {
+        const VkImageCopy* region = &entry->copy.imageRegions[regionIdx];
+        const VkImageCopy* otherRegion = &other->copy.imageRegions[otherRegionIdx];
+        bool isSameImage = entry->copy.srcImage == entry->copy.dstImage;
+
+        return imageRegionsOverlap(&region->dstSubresource, &region->dstOffset, &region->extent,
+                                   &otherRegion->dstSubresource, &otherRegion->dstOffset,
+                                   &otherRegion->extent) ||
+               (isSameImage &&
+                imageRegionsOverlap(&region->srcSubresource, &region->srcOffset, &region->extent,
+                                    &otherRegion->dstSubresource, &otherRegion->dstOffset,
+                                    &otherRegion->extent)) ||
+               (isSameImage &&
+                imageRegionsOverlap(&region->dstSubresource, &region->dstOffset, &region->extent,
+                                    &otherRegion->srcSubresource, &otherRegion->srcOffset,
+                                    &otherRegion->extent));
+    } else if (entry->type == CMD_RESOLVE_IMAGE) {
+        const VkImageResolve* region = &entry->copy.resolveRegions[regionIdx];
+        const VkImageResolve* otherRegion = &other->copy.resolveRegions[otherRegionIdx];
+
+        // The source and destination images of a resolve are always different
+        return imageRegionsOverlap(&region->dstSubresource, &region->dstOffset, &region->extent,
+                                   &otherRegion->dstSubresource, &otherRegion->dstOffset,
+                                   &otherRegion->extent);
+    } else if (entry->type == CMD_COPY_BUFFER_TO_IMAGE) {
+        const VkBufferImageCopy* region = &entry->copy.bufferImageRegions[regionIdx];
+        const VkBufferImageCopy* otherRegion = &other->copy.bufferImageRegions[otherRegionIdx];
+
+        return imageRegionsOverlap(&region->imageSubresource, &region->imageOffset,
+                                   &region->imageExtent, &otherRegion->imageSubresource,
+                                   &otherRegion->imageOffset, &otherRegion->imageExtent);
+    }
+
+    // The memory range written by an image to memory copy depends on the format, assume the worst
+    return true;
+}
+
+static size_t getCopyRegionSize(
+    CmdType type)
+{
+    switch (type) {
+    case CMD_COPY_BUFFER:
+        return sizeof(VkBufferCopy);
+    case CMD_COPY_IMAGE:
+        return sizeof(VkImageCopy);
+    case CMD_RESOLVE_IMAGE:
+        return sizeof(VkImageResolve);
+    default:
+        return sizeof(VkBufferImageCopy);
+    }
+}
+
+static bool canMergeCopy(
+    const CmdEntry* firstEntry,
+    const CmdEntry* other)
+{
+    if (other->type != firstEntry->type ||
+        other->copy.srcBuffer != firstEntry->copy.srcBuffer ||
+        other->copy.dstBuffer != firstEntry->copy.dstBuffer ||
+        other->copy.srcImage != firstEntry->copy.srcImage ||
+        other->copy.dstImage != firstEntry->copy.dstImage ||
+        other->copy.srcLayout != firstEntry->copy.srcLayout ||
+        other->copy.dstLayout != firstEntry->copy.dstLayout) {
+        return false;
+    }
+
+    for (const CmdEntry* entry = firstEntry; entry != other; entry = entry->next) {
+        if (entry->type == CMD_NOP) {
+            continue;
+        }
+
+        for (int i = 0; i < entry->copy.regionCount; i++) {
+            for (int j = 0; j < other->copy.regionCount; j++) {
+                if (copyRegionsOverlap(entry, i, other, j)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Coalesces buffer regions that are contiguous on both sides, returns the new region count
+static uint32_t coalesceBufferCopyRegions(
+    uint32_t regionCount,
+    VkBufferCopy* regions)
 {
-    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    uint32_t coalescedCount = 0;
 
-    VkImageView attachments[GR_MAX_COLOR_TARGETS + 1];
-    int attachmentIdx = 0;
+    for (int i = 0; i < regionCount; i++) {
+        VkBufferCopy* prevRegion = coalescedCount > 0 ? &regions[coalescedCount - 1] : NULL;
 
-    for (int i = 0; i < colorTargetCount; i++) {
-        GrColorTargetView* grColorTargetView = (GrColorTargetView*)pColorTargets[i].view;
+        if (prevRegion != NULL &&
+            prevRegion->srcOffset + prevRegion->size == regions[i].srcOffset &&
+            prevRegion->dstOffset + prevRegion->size == regions[i].dstOffset) {
+            prevRegion->size += regions[i].size;
+        } else {
+            regions[coalescedCount] = regions[i];
+            coalescedCount++;
+        }
+    }
+
+    return coalescedCount;
+}
+
+// Collects runs of copies between the same resources into a single copy with multiple regions.
+// Updates are staged back-to-back, so the regions of consecutive updates usually coalesce.
+static void mergeCopies(
+    GrCmdBuffer* grCmdBuffer)
+{
+    for (CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        if (entry->type != CMD_COPY_BUFFER && entry->type != CMD_COPY_IMAGE &&
+            entry->type != CMD_COPY_BUFFER_TO_IMAGE && entry->type != CMD_RESOLVE_IMAGE) {
+            continue;
+        }
+
+        const CmdEntry* lastEntry = entry;
+        uint32_t regionCount = entry->copy.regionCount;
+        for (const CmdEntry* other = entry->next; other != NULL; other = other->next) {
+            if (other->type == CMD_NOP) {
+                continue;
+            } else if (!canMergeCopy(entry, other)) {
+                break;
+            }
 
-        attachments[attachmentIdx++] = grColorTargetView->imageView;
+            lastEntry = other;
+            regionCount += other->copy.regionCount;
+        }
+
+        if (lastEntry == entry) {
+            continue;
+        }
+
+        size_t regionSize = getCopyRegionSize(entry->type);
+        uint8_t* regions = allocArena(grCmdBuffer->arena, regionSize * regionCount);
+        uint32_t mergedRegionCount = 0;
+        for (CmdEntry* other = entry; other != lastEntry->next; other = other->next) {
+            if (other->type == CMD_NOP) {
+                continue;
+            }
+
+            memcpy(&regions[regionSize * mergedRegionCount], other->copy.regions,
+                   regionSize * other->copy.regionCount);
+            mergedRegionCount += other->copy.regionCount;
+
+            if (other != entry) {
+                other->type = CMD_NOP;
+                grCmdBuffer->stats.mergedTransferCount++;
+            }
+        }
+
+        entry->copy.regionCount = mergedRegionCount;
+        entry->copy.regions = regions;
+
+        if (entry->type == CMD_COPY_BUFFER) {
+            entry->copy.regionCount = coalesceBufferCopyRegions(entry->copy.regionCount,
+                                                                entry->copy.bufferRegions);
+        }
     }
+}
 
-    // TODO
-    if (pDepthTarget != NULL) {
-        printf("%s: depth targets are not supported\n", __func__);
+// Merges back-to-back fills of the same value whose ranges touch or overlap
+static void mergeFills(
+    GrCmdBuffer* grCmdBuffer)
+{
+    CmdEntry* fillEntry = NULL;
+
+    for (CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        if (entry->type == CMD_NOP) {
+            continue;
+        } else if (entry->type != CMD_FILL_BUFFER) {
+            fillEntry = NULL;
+            continue;
+        }
+
+        if (fillEntry != NULL &&
+            fillEntry->fillBuffer.dstBuffer == entry->fillBuffer.dstBuffer &&
+            fillEntry->fillBuffer.data == entry->fillBuffer.data &&
+            fillEntry->fillBuffer.offset <= entry->fillBuffer.offset + entry->fillBuffer.size &&
+            entry->fillBuffer.offset <= fillEntry->fillBuffer.offset + fillEntry->fillBuffer.size) {
+            VkDeviceSize start = MIN(fillEntry->fillBuffer.offset, entry->fillBuffer.offset);
+            VkDeviceSize end = MAX(fillEntry->fillBuffer.offset + fillEntry->fillBuffer.size,
+                                   entry->fillBuffer.offset + entry->fillBuffer.size);
+
+            fillEntry->fillBuffer.offset = start;
+            fillEntry->fillBuffer.size = end - start;
+            grCmdBuffer->stats.mergedTransferCount++;
+            entry->type = CMD_NOP;
+        } else {
+            fillEntry = entry;
+        }
     }
+}
+
+GR_RESULT lowerCmdBuffer(
+    GrCmdBuffer* grCmdBuffer)
+{
+    removeDeadBinds(grCmdBuffer);
+    mergeBarriers(grCmdBuffer);
+    foldClears(grCmdBuffer);
+    findAttachmentClears(grCmdBuffer);
+    mergeIndirectDraws(grCmdBuffer);
+    mergeCopies(grCmdBuffer);
+    mergeFills(grCmdBuffer);
+
+    grCmdBuffer->grPipeline = NULL;
+    grCmdBuffer->grDescriptorSet = NULL;
+    grCmdBuffer->indexGrGpuMemory = NULL;
+    grCmdBuffer->dynamicMemoryView = (VkDescriptorBufferInfo) {};
+    grCmdBuffer->colorTargetCount = 0;
+    grCmdBuffer->hasDepthTarget = false;
+    grCmdBuffer->hasActiveRenderPass = false;
+    grCmdBuffer->pendingLoadOpCount = 0;
+    grCmdBuffer->grViewportState = NULL;
+    grCmdBuffer->grRasterState = NULL;
+    grCmdBuffer->grDepthStencilState = NULL;
+    grCmdBuffer->grColorBlendState = NULL;
+    grCmdBuffer->dirtyStateFlags = 0;
+    grCmdBuffer->validDynamicStateFlags = 0;
+    grCmdBuffer->computeGrPipeline = NULL;
+    grCmdBuffer->computeGrDescriptorSet = NULL;
+    grCmdBuffer->computeDynamicMemoryView = (VkDescriptorBufferInfo) {};
+    grCmdBuffer->computeDirtyStateFlags = 0;
 
-    const VkFramebufferCreateInfo framebufferCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = NULL,
-        .flags = 0,
-        .renderPass = renderPass,
-        .attachmentCount = attachmentIdx,
-        .pAttachments = attachments,
-        .width = 1280, // FIXME hardcoded
-        .height = 720, // FIXME hardcoded
-        .layers = 1, // FIXME hardcoded
+        .flags = grCmdBuffer->usageFlags,
+        .pInheritanceInfo = NULL,
     };
 
-    if (vki.vkCreateFramebuffer(device, &framebufferCreateInfo, NULL,
-                                &framebuffer) != VK_SUCCESS) {
-        printf("%s: vkCreateFramebuffer failed\n", __func__);
-        return VK_NULL_HANDLE;
+    if (vki.vkBeginCommandBuffer(grCmdBuffer->commandBuffer, &beginInfo) != VK_SUCCESS) {
+        printf("%s: vkBeginCommandBuffer failed\n", __func__);
+        return GR_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (const CmdEntry* entry = grCmdBuffer->firstEntry; entry != NULL; entry = entry->next) {
+        lowerCmdEntry(grCmdBuffer, entry);
+    }
+
+    endRenderPass(grCmdBuffer);
+
+    if (vki.vkEndCommandBuffer(grCmdBuffer->commandBuffer) != VK_SUCCESS) {
+        printf("%s: vkEndCommandBuffer failed\n", __func__);
+        return GR_ERROR_OUT_OF_MEMORY;
     }
 
-    return framebuffer;
+    return GR_SUCCESS;
 }
 
-static void initCmdBufferResources(
-    GrCmdBuffer* grCmdBuffer)
+static CmdEntry* appendCmdEntry(
+    GrCmdBuffer* grCmdBuffer,
+    CmdType type)
 {
-    GrPipeline* grPipeline = grCmdBuffer->grPipeline;
-    VkPipelineBindPoint bindPoint = getVkPipelineBindPoint(GR_PIPELINE_BIND_POINT_GRAPHICS);
+    CmdEntry* entry = allocArena(grCmdBuffer->arena, sizeof(CmdEntry));
 
-    vki.vkCmdBindPipeline(grCmdBuffer->commandBuffer, bindPoint, grPipeline->pipeline);
+    entry->next = NULL;
+    entry->type = type;
 
-    printf("%s: HACK only one descriptor bound\n", __func__);
-    vki.vkCmdBindDescriptorSets(grCmdBuffer->commandBuffer, bindPoint,
-                                grPipeline->pipelineLayout, 0, 1,
-                                grCmdBuffer->grDescriptorSet->descriptorSets, 0, NULL);
+    if (grCmdBuffer->lastEntry == NULL) {
+        grCmdBuffer->firstEntry = entry;
+    } else {
+        grCmdBuffer->lastEntry->next = entry;
+    }
+    grCmdBuffer->lastEntry = entry;
 
-    VkFramebuffer framebuffer =
-        getVkFramebuffer(grCmdBuffer->grDescriptorSet->device, grPipeline->renderPass,
-                         grCmdBuffer->colorTargetCount, grCmdBuffer->colorTargets,
-                         grCmdBuffer->hasDepthTarget ? &grCmdBuffer->depthTarget : NULL);
+    return entry;
+}
 
-    const VkRenderPassBeginInfo beginInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .pNext = NULL,
-        .renderPass = grPipeline->renderPass,
-        .framebuffer = framebuffer,
-        .renderArea = (VkRect2D) {
-            .offset = { 0, 0 }, // FIXME hardcoded
-            .extent = { 1280, 720 }, // FIXME hardcoded
-        },
-        .clearValueCount = 0,
-        .pClearValues = NULL,
-    };
+static void recordClearImage(
+    GrCmdBuffer* grCmdBuffer,
+    CmdType type,
+    GrImage* grImage,
+    const VkClearValue* clearValue,
+    uint32_t rangeCount,
+    const GR_IMAGE_SUBRESOURCE_RANGE* pRanges)
+{
+    VkImageSubresourceRange* vkRanges =
+        allocArena(grCmdBuffer->arena, sizeof(VkImageSubresourceRange) * rangeCount);
 
-    if (grCmdBuffer->hasActiveRenderPass) {
-        vki.vkCmdEndRenderPass(grCmdBuffer->commandBuffer);
+    for (int i = 0; i < rangeCount; i++) {
+        vkRanges[i] = getVkImageSubresourceRange(&pRanges[i]);
     }
-    vki.vkCmdBeginRenderPass(grCmdBuffer->commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
-    grCmdBuffer->hasActiveRenderPass = true;
 
-    grCmdBuffer->isDirty = false;
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, type);
+    entry->clearImage.grImage = grImage;
+    entry->clearImage.clearValue = *clearValue;
+    entry->clearImage.rangeCount = rangeCount;
+    entry->clearImage.ranges = vkRanges;
+    entry->clearImage.isFolded = false;
+    entry->clearImage.isAttachmentClear = false;
+}
+
+static CmdEntry* appendCopyEntry(
+    GrCmdBuffer* grCmdBuffer,
+    CmdType type,
+    void* regions)
+{
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, type);
+
+    memset(&entry->copy, 0, sizeof(entry->copy));
+    entry->copy.regions = regions;
+
+    return entry;
+}
+
+// Images are copied in the layout of their current state, or the layout of the given default state
+// if the command buffer didn't transition them
+static VkImageLayout getTransferImageLayout(
+    const GrCmdBuffer* grCmdBuffer,
+    const GrImage* grImage,
+    const VkImageSubresourceLayers* subresource,
+    GR_IMAGE_STATE defaultState)
+{
+    VkImageLayout layout = getImageStateLayout(grCmdBuffer->imageStateTracker, grImage,
+                                               subresource->aspectMask, subresource->mipLevel,
+                                               subresource->baseArrayLayer);
+
+    return layout != VK_IMAGE_LAYOUT_MAX_ENUM ? layout : getVkImageLayout(defaultState);
+}
+
+static VkImageLayout getCopyImageLayout(
+    const GrCmdBuffer* grCmdBuffer,
+    const GrImage* grImage,
+    const VkImageSubresourceLayers* subresource)
+{
+    return getTransferImageLayout(grCmdBuffer, grImage, subresource,
+                                  GR_IMAGE_STATE_DATA_TRANSFER);
+}
+
+static void recordCopyBufferImage(
+    GrCmdBuffer* grCmdBuffer,
+    CmdType type,
+    GrGpuMemory* grGpuMemory,
+    GrImage* grImage,
+    uint32_t regionCount,
+    const GR_MEMORY_IMAGE_COPY* pRegions)
+{
+    bool isToImage = type == CMD_COPY_BUFFER_TO_IMAGE;
+    VkBufferImageCopy* vkRegions =
+        allocArena(grCmdBuffer->arena, sizeof(VkBufferImageCopy) * regionCount);
+    CmdEntry* entry = NULL;
+
+    for (int i = 0; i < regionCount; i++) {
+        const GR_MEMORY_IMAGE_COPY* region = &pRegions[i];
+
+        // Memory is tightly packed
+        vkRegions[i] = (VkBufferImageCopy) {
+            .bufferOffset = region->memOffset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = getVkImageSubresourceLayers(&region->imageSubresource),
+            .imageOffset = { region->imageOffset.x, region->imageOffset.y, region->imageOffset.z },
+            .imageExtent = {
+                region->imageExtent.width, region->imageExtent.height, region->imageExtent.depth,
+            },
+        };
+
+        // A single copy takes one layout for all regions
+        VkImageLayout layout = getCopyImageLayout(grCmdBuffer, grImage,
+                                                  &vkRegions[i].imageSubresource);
+        if (entry == NULL ||
+            (isToImage ? entry->copy.dstLayout : entry->copy.srcLayout) != layout) {
+            entry = appendCopyEntry(grCmdBuffer, type, &vkRegions[i]);
+
+            if (isToImage) {
+                entry->copy.srcBuffer = grGpuMemory->buffer;
+                entry->copy.dstImage = grImage;
+                entry->copy.dstLayout = layout;
+            } else {
+                entry->copy.srcImage = grImage;
+                entry->copy.srcLayout = layout;
+                entry->copy.dstBuffer = grGpuMemory->buffer;
+            }
+        }
+
+        entry->copy.regionCount++;
+    }
 }
 
 // Command Buffer Building Functions
@@ -106,14 +2158,16 @@ GR_VOID grCmdBindPipeline(
     GR_PIPELINE pipeline)
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
-    GrPipeline* grPipeline = (GrPipeline*)pipeline;
 
-    if (pipelineBindPoint != GR_PIPELINE_BIND_POINT_GRAPHICS) {
+    if (pipelineBindPoint != GR_PIPELINE_BIND_POINT_GRAPHICS &&
+        pipelineBindPoint != GR_PIPELINE_BIND_POINT_COMPUTE) {
         printf("%s: unsupported bind point 0x%x\n", __func__, pipelineBindPoint);
+        return;
     }
 
-    grCmdBuffer->grPipeline = grPipeline;
-    grCmdBuffer->isDirty = true;
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BIND_PIPELINE);
+    entry->bindPipeline.bindPoint = pipelineBindPoint;
+    entry->bindPipeline.grPipeline = (GrPipeline*)pipeline;
 }
 
 GR_VOID grCmdBindStateObject(
@@ -122,67 +2176,10 @@ GR_VOID grCmdBindStateObject(
     GR_STATE_OBJECT state)
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
-    GrViewportStateObject* viewportState = (GrViewportStateObject*)state;
-    GrRasterStateObject* rasterState = (GrRasterStateObject*)state;
-    GrDepthStencilStateObject* depthStencilState = (GrDepthStencilStateObject*)state;
-    GrColorBlendStateObject* colorBlendState = (GrColorBlendStateObject*)state;
 
-    switch ((GR_STATE_BIND_POINT)stateBindPoint) {
-    case GR_STATE_BIND_VIEWPORT:
-        vki.vkCmdSetViewportWithCountEXT(grCmdBuffer->commandBuffer,
-                                         viewportState->viewportCount, viewportState->viewports);
-        vki.vkCmdSetScissorWithCountEXT(grCmdBuffer->commandBuffer, viewportState->scissorCount,
-                                        viewportState->scissors);
-        break;
-    case GR_STATE_BIND_RASTER:
-        vki.vkCmdSetCullModeEXT(grCmdBuffer->commandBuffer, rasterState->cullMode);
-        vki.vkCmdSetFrontFaceEXT(grCmdBuffer->commandBuffer, rasterState->frontFace);
-        vki.vkCmdSetDepthBias(grCmdBuffer->commandBuffer, rasterState->depthBiasConstantFactor,
-                              rasterState->depthBiasClamp, rasterState->depthBiasSlopeFactor);
-        break;
-    case GR_STATE_BIND_DEPTH_STENCIL:
-        vki.vkCmdSetDepthTestEnableEXT(grCmdBuffer->commandBuffer,
-                                       depthStencilState->depthTestEnable);
-        vki.vkCmdSetDepthWriteEnableEXT(grCmdBuffer->commandBuffer,
-                                        depthStencilState->depthWriteEnable);
-        vki.vkCmdSetDepthCompareOpEXT(grCmdBuffer->commandBuffer,
-                                      depthStencilState->depthCompareOp);
-        vki.vkCmdSetDepthBoundsTestEnableEXT(grCmdBuffer->commandBuffer,
-                                             depthStencilState->depthBoundsTestEnable);
-        vki.vkCmdSetStencilTestEnableEXT(grCmdBuffer->commandBuffer,
-                                         depthStencilState->stencilTestEnable);
-        vki.vkCmdSetStencilOpEXT(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                 depthStencilState->front.failOp,
-                                 depthStencilState->front.passOp,
-                                 depthStencilState->front.depthFailOp,
-                                 depthStencilState->front.compareOp);
-        vki.vkCmdSetStencilCompareMask(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                       depthStencilState->front.compareMask);
-        vki.vkCmdSetStencilWriteMask(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                     depthStencilState->front.writeMask);
-        vki.vkCmdSetStencilReference(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_FRONT_BIT,
-                                     depthStencilState->front.reference);
-        vki.vkCmdSetStencilOpEXT(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_BACK_BIT,
-                                 depthStencilState->back.failOp,
-                                 depthStencilState->back.passOp,
-                                 depthStencilState->back.depthFailOp,
-                                 depthStencilState->back.compareOp);
-        vki.vkCmdSetStencilCompareMask(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_BACK_BIT,
-                                       depthStencilState->back.compareMask);
-        vki.vkCmdSetStencilWriteMask(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_BACK_BIT,
-                                     depthStencilState->back.writeMask);
-        vki.vkCmdSetStencilReference(grCmdBuffer->commandBuffer, VK_STENCIL_FACE_BACK_BIT,
-                                     depthStencilState->back.reference);
-        vki.vkCmdSetDepthBounds(grCmdBuffer->commandBuffer,
-                                depthStencilState->minDepthBounds, depthStencilState->maxDepthBounds);
-        break;
-    case GR_STATE_BIND_COLOR_BLEND:
-        vki.vkCmdSetBlendConstants(grCmdBuffer->commandBuffer, colorBlendState->blendConstants);
-        break;
-    case GR_STATE_BIND_MSAA:
-        // TODO
-        break;
-    }
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BIND_STATE_OBJECT);
+    entry->bindStateObject.bindPoint = stateBindPoint;
+    entry->bindStateObject.state = (GrObject*)state;
 }
 
 GR_VOID grCmdBindDescriptorSet(
@@ -193,18 +2190,20 @@ GR_VOID grCmdBindDescriptorSet(
     GR_UINT slotOffset)
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
-    GrDescriptorSet* grDescriptorSet = (GrDescriptorSet*)descriptorSet;
 
-    if (pipelineBindPoint != GR_PIPELINE_BIND_POINT_GRAPHICS) {
+    if (pipelineBindPoint != GR_PIPELINE_BIND_POINT_GRAPHICS &&
+        pipelineBindPoint != GR_PIPELINE_BIND_POINT_COMPUTE) {
         printf("%s: unsupported bind point 0x%x\n", __func__, pipelineBindPoint);
+        return;
     } else if (index != 0) {
         printf("%s: unsupported index %u\n", __func__, index);
     } else if (slotOffset != 0) {
         printf("%s: unsupported slot offset %u\n", __func__, slotOffset);
     }
 
-    grCmdBuffer->grDescriptorSet = grDescriptorSet;
-    grCmdBuffer->isDirty = true;
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BIND_DESCRIPTOR_SET);
+    entry->bindDescriptorSet.bindPoint = pipelineBindPoint;
+    entry->bindDescriptorSet.grDescriptorSet = (GrDescriptorSet*)descriptorSet;
 }
 
 GR_VOID grCmdPrepareMemoryRegions(
@@ -213,24 +2212,93 @@ GR_VOID grCmdPrepareMemoryRegions(
     const GR_MEMORY_STATE_TRANSITION* pStateTransitions)
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    VkBufferMemoryBarrier* barriers =
+        allocArena(grCmdBuffer->arena, sizeof(VkBufferMemoryBarrier) * transitionCount);
+    uint32_t barrierCount = 0;
+    VkPipelineStageFlags srcStageMask = 0;
+    VkPipelineStageFlags dstStageMask = 0;
 
     for (int i = 0; i < transitionCount; i++) {
         const GR_MEMORY_STATE_TRANSITION* stateTransition = &pStateTransitions[i];
+        GrGpuMemory* grGpuMemory = (GrGpuMemory*)stateTransition->mem;
 
-        // TODO use buffer memory barrier
-        const VkMemoryBarrier memoryBarrier = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        srcStageMask |= getVkPipelineStageFlagsMemory(stateTransition->oldState);
+        dstStageMask |= getVkPipelineStageFlagsMemory(stateTransition->newState);
+
+        const VkBufferMemoryBarrier bufferMemoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
             .pNext = NULL,
             .srcAccessMask = getVkAccessFlagsMemory(stateTransition->oldState),
             .dstAccessMask = getVkAccessFlagsMemory(stateTransition->newState),
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = grGpuMemory->buffer,
+            .offset = stateTransition->offset,
+            .size = stateTransition->regionSize,
         };
 
-        // TODO batch
-        vki.vkCmdPipelineBarrier(grCmdBuffer->commandBuffer,
-                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
-                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
-                                 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+        bool merged = false;
+        for (int j = 0; j < barrierCount; j++) {
+            if (mergeBufferMemoryBarriers(&barriers[j], &bufferMemoryBarrier)) {
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged) {
+            barriers[barrierCount] = bufferMemoryBarrier;
+            barrierCount++;
+        }
+    }
+
+    if (barrierCount > 0) {
+        CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BARRIER);
+        entry->barrier.srcStageMask = srcStageMask;
+        entry->barrier.dstStageMask = dstStageMask;
+        entry->barrier.bufferBarrierCount = barrierCount;
+        entry->barrier.bufferBarriers = barriers;
+        entry->barrier.imageBarrierCount = 0;
+        entry->barrier.imageBarriers = NULL;
+        entry->barrier.clearedTarget = NULL;
+    }
+}
+
+GR_VOID grCmdBindIndexData(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY mem,
+    GR_GPU_SIZE offset,
+    GR_ENUM indexType)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BIND_INDEX_DATA);
+    entry->bindIndexData.grGpuMemory = (GrGpuMemory*)mem;
+    entry->bindIndexData.offset = offset;
+    entry->bindIndexData.indexType = getVkIndexType(indexType);
+}
+
+GR_VOID grCmdBindDynamicMemoryView(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_ENUM pipelineBindPoint,
+    const GR_MEMORY_VIEW_ATTACH_INFO* pMemView)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrGpuMemory* grGpuMemory = (GrGpuMemory*)pMemView->mem;
+
+    if (pipelineBindPoint != GR_PIPELINE_BIND_POINT_GRAPHICS &&
+        pipelineBindPoint != GR_PIPELINE_BIND_POINT_COMPUTE) {
+        printf("%s: unsupported bind point 0x%x\n", __func__, pipelineBindPoint);
+        return;
     }
+
+    // The view format and stride are left to the shader, which reads it as a raw buffer
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BIND_DYNAMIC_MEMORY_VIEW);
+    entry->bindDynamicMemoryView.bindPoint = pipelineBindPoint;
+    entry->bindDynamicMemoryView.bufferInfo = (VkDescriptorBufferInfo) {
+        .buffer = grGpuMemory->buffer,
+        .offset = pMemView->offset,
+        .range = pMemView->range,
+    };
 }
 
 GR_VOID grCmdBindTargets(
@@ -240,17 +2308,21 @@ GR_VOID grCmdBindTargets(
     const GR_DEPTH_STENCIL_BIND_INFO* pDepthTarget)
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GR_COLOR_TARGET_BIND_INFO* colorTargets =
+        allocArena(grCmdBuffer->arena, sizeof(GR_COLOR_TARGET_BIND_INFO) * colorTargetCount);
+    GR_DEPTH_STENCIL_BIND_INFO* depthTarget = NULL;
 
-    memcpy(grCmdBuffer->colorTargets, pColorTargets,
-           sizeof(GR_COLOR_TARGET_BIND_INFO) * colorTargetCount);
-    grCmdBuffer->colorTargetCount = colorTargetCount;
+    memcpy(colorTargets, pColorTargets, sizeof(GR_COLOR_TARGET_BIND_INFO) * colorTargetCount);
 
-    if (pDepthTarget == NULL) {
-        grCmdBuffer->hasDepthTarget = false;
-    } else {
-        memcpy(&grCmdBuffer->depthTarget, pDepthTarget, sizeof(GR_DEPTH_STENCIL_BIND_INFO));
-        grCmdBuffer->hasDepthTarget = true;
+    if (pDepthTarget != NULL) {
+        depthTarget = allocArena(grCmdBuffer->arena, sizeof(GR_DEPTH_STENCIL_BIND_INFO));
+        *depthTarget = *pDepthTarget;
     }
+
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BIND_TARGETS);
+    entry->bindTargets.colorTargetCount = colorTargetCount;
+    entry->bindTargets.colorTargets = colorTargets;
+    entry->bindTargets.depthTarget = depthTarget;
 }
 
 GR_VOID grCmdPrepareImages(
@@ -258,12 +2330,35 @@ GR_VOID grCmdPrepareImages(
     GR_UINT transitionCount,
     const GR_IMAGE_STATE_TRANSITION* pStateTransitions)
 {
-    const GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    VkImageMemoryBarrier* barriers =
+        allocArena(grCmdBuffer->arena, sizeof(VkImageMemoryBarrier) * transitionCount);
+    uint32_t barrierCount = 0;
+    VkPipelineStageFlags srcStageMask = 0;
+    VkPipelineStageFlags dstStageMask = 0;
 
     for (int i = 0; i < transitionCount; i++) {
         const GR_IMAGE_STATE_TRANSITION* stateTransition = &pStateTransitions[i];
         const GR_IMAGE_SUBRESOURCE_RANGE* range = &stateTransition->subresourceRange;
         GrImage* grImage = (GrImage*)stateTransition->image;
+        VkImageSubresourceRange subresourceRange = getVkImageSubresourceRange(range);
+
+        if (!updateImageState(grCmdBuffer->imageStateTracker, grImage, &subresourceRange,
+                              stateTransition->oldState, stateTransition->newState)) {
+            continue;
+        }
+
+        // Discarded contents don't need a barrier, the transition out of the discard state
+        // starts from an undefined layout
+        if (stateTransition->newState == GR_IMAGE_STATE_DISCARD) {
+            CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_DISCARD_IMAGE);
+            entry->discardImage.grImage = grImage;
+            entry->discardImage.aspectMask = subresourceRange.aspectMask;
+            continue;
+        }
+
+        srcStageMask |= getVkPipelineStageFlagsImage(stateTransition->oldState);
+        dstStageMask |= getVkPipelineStageFlagsImage(stateTransition->newState);
 
         const VkImageMemoryBarrier imageMemoryBarrier = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -275,14 +2370,32 @@ GR_VOID grCmdPrepareImages(
             .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
             .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
             .image = grImage->image,
-            .subresourceRange = getVkImageSubresourceRange(range),
+            .subresourceRange = subresourceRange,
         };
 
-        // TODO batch
-        vki.vkCmdPipelineBarrier(grCmdBuffer->commandBuffer,
-                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
-                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
-                                 0, 0, NULL, 0, NULL, 1, &imageMemoryBarrier);
+        bool merged = false;
+        for (int j = 0; j < barrierCount; j++) {
+            if (mergeImageMemoryBarriers(&barriers[j], &imageMemoryBarrier)) {
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged) {
+            barriers[barrierCount] = imageMemoryBarrier;
+            barrierCount++;
+        }
+    }
+
+    if (barrierCount > 0) {
+        CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_BARRIER);
+        entry->barrier.srcStageMask = srcStageMask;
+        entry->barrier.dstStageMask = dstStageMask;
+        entry->barrier.bufferBarrierCount = 0;
+        entry->barrier.bufferBarriers = NULL;
+        entry->barrier.imageBarrierCount = barrierCount;
+        entry->barrier.imageBarriers = barriers;
+        entry->barrier.clearedTarget = NULL;
     }
 }
 
@@ -295,12 +2408,11 @@ GR_VOID grCmdDraw(
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
 
-    if (grCmdBuffer->isDirty) {
-        initCmdBufferResources(grCmdBuffer);
-    }
-
-    vki.vkCmdDraw(grCmdBuffer->commandBuffer,
-                  vertexCount, instanceCount, firstVertex, firstInstance);
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_DRAW);
+    entry->draw.firstVertex = firstVertex;
+    entry->draw.vertexCount = vertexCount;
+    entry->draw.firstInstance = firstInstance;
+    entry->draw.instanceCount = instanceCount;
 }
 
 GR_VOID grCmdDrawIndexed(
@@ -313,12 +2425,300 @@ GR_VOID grCmdDrawIndexed(
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
 
-    if (grCmdBuffer->isDirty) {
-        initCmdBufferResources(grCmdBuffer);
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_DRAW_INDEXED);
+    entry->drawIndexed.firstIndex = firstIndex;
+    entry->drawIndexed.indexCount = indexCount;
+    entry->drawIndexed.vertexOffset = vertexOffset;
+    entry->drawIndexed.firstInstance = firstInstance;
+    entry->drawIndexed.instanceCount = instanceCount;
+}
+
+GR_VOID grCmdDrawIndirect(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY mem,
+    GR_GPU_SIZE offset)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_DRAW_INDIRECT);
+    entry->drawIndirect.grGpuMemory = (GrGpuMemory*)mem;
+    entry->drawIndirect.offset = offset;
+    entry->drawIndirect.drawCount = 1;
+}
+
+GR_VOID grCmdDrawIndexedIndirect(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY mem,
+    GR_GPU_SIZE offset)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_DRAW_INDEXED_INDIRECT);
+    entry->drawIndirect.grGpuMemory = (GrGpuMemory*)mem;
+    entry->drawIndirect.offset = offset;
+    entry->drawIndirect.drawCount = 1;
+}
+
+GR_VOID grCmdDispatch(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_UINT x,
+    GR_UINT y,
+    GR_UINT z)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_DISPATCH);
+    entry->dispatch.x = x;
+    entry->dispatch.y = y;
+    entry->dispatch.z = z;
+}
+
+GR_VOID grCmdDispatchIndirect(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY mem,
+    GR_GPU_SIZE offset)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_DISPATCH_INDIRECT);
+    entry->dispatchIndirect.grGpuMemory = (GrGpuMemory*)mem;
+    entry->dispatchIndirect.offset = offset;
+}
+
+GR_VOID grCmdCopyMemory(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY srcMem,
+    GR_GPU_MEMORY destMem,
+    GR_UINT regionCount,
+    const GR_MEMORY_COPY* pRegions)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrGpuMemory* grSrcGpuMemory = (GrGpuMemory*)srcMem;
+    GrGpuMemory* grDstGpuMemory = (GrGpuMemory*)destMem;
+    VkBufferCopy* vkRegions = allocArena(grCmdBuffer->arena, sizeof(VkBufferCopy) * regionCount);
+
+    for (int i = 0; i < regionCount; i++) {
+        vkRegions[i] = (VkBufferCopy) {
+            .srcOffset = pRegions[i].srcOffset,
+            .dstOffset = pRegions[i].destOffset,
+            .size = pRegions[i].copySize,
+        };
+    }
+
+    CmdEntry* entry = appendCopyEntry(grCmdBuffer, CMD_COPY_BUFFER, vkRegions);
+    entry->copy.srcBuffer = grSrcGpuMemory->buffer;
+    entry->copy.dstBuffer = grDstGpuMemory->buffer;
+    entry->copy.regionCount = regionCount;
+}
+
+GR_VOID grCmdCloneImageData(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_IMAGE srcImage,
+    GR_ENUM srcImageState,
+    GR_IMAGE destImage,
+    GR_ENUM destImageState)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrImage* grSrcImage = (GrImage*)srcImage;
+    GrImage* grDstImage = (GrImage*)destImage;
+    VkImageAspectFlags aspectMask = getVkFormatAspectFlags(grSrcImage->format);
+    VkImageCopy* vkRegions =
+        allocArena(grCmdBuffer->arena, sizeof(VkImageCopy) * grSrcImage->mipLevels);
+
+    // Both images share the same create info, copy every mip level with all of its slices at once
+    for (int i = 0; i < grSrcImage->mipLevels; i++) {
+        const VkImageSubresourceLayers subresource = {
+            .aspectMask = aspectMask,
+            .mipLevel = i,
+            .baseArrayLayer = 0,
+            .layerCount = grSrcImage->arrayLayers,
+        };
+
+        vkRegions[i] = (VkImageCopy) {
+            .srcSubresource = subresource,
+            .srcOffset = { 0, 0, 0 },
+            .dstSubresource = subresource,
+            .dstOffset = { 0, 0, 0 },
+            .extent = {
+                MAX(grSrcImage->extent.width >> i, 1),
+                MAX(grSrcImage->extent.height >> i, 1),
+                MAX(grSrcImage->extent.depth >> i, 1),
+            },
+        };
+    }
+
+    CmdEntry* entry = appendCopyEntry(grCmdBuffer, CMD_COPY_IMAGE, vkRegions);
+    entry->copy.srcImage = grSrcImage;
+    entry->copy.srcLayout = getVkImageLayout(srcImageState);
+    entry->copy.dstImage = grDstImage;
+    entry->copy.dstLayout = getVkImageLayout(destImageState);
+    entry->copy.regionCount = grSrcImage->mipLevels;
+}
+
+GR_VOID grCmdCopyImage(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_IMAGE srcImage,
+    GR_IMAGE destImage,
+    GR_UINT regionCount,
+    const GR_IMAGE_COPY* pRegions)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrImage* grSrcImage = (GrImage*)srcImage;
+    GrImage* grDstImage = (GrImage*)destImage;
+    VkImageCopy* vkRegions = allocArena(grCmdBuffer->arena, sizeof(VkImageCopy) * regionCount);
+    CmdEntry* entry = NULL;
+
+    for (int i = 0; i < regionCount; i++) {
+        const GR_IMAGE_COPY* region = &pRegions[i];
+
+        vkRegions[i] = (VkImageCopy) {
+            .srcSubresource = getVkImageSubresourceLayers(&region->srcSubresource),
+            .srcOffset = { region->srcOffset.x, region->srcOffset.y, region->srcOffset.z },
+            .dstSubresource = getVkImageSubresourceLayers(&region->destSubresource),
+            .dstOffset = { region->destOffset.x, region->destOffset.y, region->destOffset.z },
+            .extent = { region->extent.width, region->extent.height, region->extent.depth },
+        };
+
+        // A single copy takes one layout per image for all regions
+        VkImageLayout srcLayout = getCopyImageLayout(grCmdBuffer, grSrcImage,
+                                                     &vkRegions[i].srcSubresource);
+        VkImageLayout dstLayout = getCopyImageLayout(grCmdBuffer, grDstImage,
+                                                     &vkRegions[i].dstSubresource);
+        if (entry == NULL ||
+            entry->copy.srcLayout != srcLayout || entry->copy.dstLayout != dstLayout) {
+            entry = appendCopyEntry(grCmdBuffer, CMD_COPY_IMAGE, &vkRegions[i]);
+            entry->copy.srcImage = grSrcImage;
+            entry->copy.srcLayout = srcLayout;
+            entry->copy.dstImage = grDstImage;
+            entry->copy.dstLayout = dstLayout;
+        }
+
+        entry->copy.regionCount++;
+    }
+}
+
+GR_VOID grCmdResolveImage(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_IMAGE srcImage,
+    GR_IMAGE destImage,
+    GR_UINT regionCount,
+    const GR_IMAGE_RESOLVE* pRegions)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrImage* grSrcImage = (GrImage*)srcImage;
+    GrImage* grDstImage = (GrImage*)destImage;
+    VkImageResolve* vkRegions =
+        allocArena(grCmdBuffer->arena, sizeof(VkImageResolve) * regionCount);
+    CmdEntry* entry = NULL;
+
+    for (int i = 0; i < regionCount; i++) {
+        const GR_IMAGE_RESOLVE* region = &pRegions[i];
+
+        vkRegions[i] = (VkImageResolve) {
+            .srcSubresource = getVkImageSubresourceLayers(&region->srcSubresource),
+            .srcOffset = { region->srcOffset.x, region->srcOffset.y, 0 },
+            .dstSubresource = getVkImageSubresourceLayers(&region->destSubresource),
+            .dstOffset = { region->destOffset.x, region->destOffset.y, 0 },
+            .extent = { region->extent.width, region->extent.height, 1 },
+        };
+
+        // A single resolve takes one layout per image for all regions
+        VkImageLayout srcLayout = getTransferImageLayout(grCmdBuffer, grSrcImage,
+                                                         &vkRegions[i].srcSubresource,
+                                                         GR_IMAGE_STATE_RESOLVE_SOURCE);
+        VkImageLayout dstLayout = getTransferImageLayout(grCmdBuffer, grDstImage,
+                                                         &vkRegions[i].dstSubresource,
+                                                         GR_IMAGE_STATE_RESOLVE_DESTINATION);
+        if (entry == NULL ||
+            entry->copy.srcLayout != srcLayout || entry->copy.dstLayout != dstLayout) {
+            entry = appendCopyEntry(grCmdBuffer, CMD_RESOLVE_IMAGE, &vkRegions[i]);
+            entry->copy.srcImage = grSrcImage;
+            entry->copy.srcLayout = srcLayout;
+            entry->copy.dstImage = grDstImage;
+            entry->copy.dstLayout = dstLayout;
+        }
+
+        entry->copy.regionCount++;
+    }
+}
+
+GR_VOID grCmdCopyMemoryToImage(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY srcMem,
+    GR_IMAGE destImage,
+    GR_UINT regionCount,
+    const GR_MEMORY_IMAGE_COPY* pRegions)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    recordCopyBufferImage(grCmdBuffer, CMD_COPY_BUFFER_TO_IMAGE, (GrGpuMemory*)srcMem,
+                          (GrImage*)destImage, regionCount, pRegions);
+}
+
+GR_VOID grCmdCopyImageToMemory(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_IMAGE srcImage,
+    GR_GPU_MEMORY destMem,
+    GR_UINT regionCount,
+    const GR_MEMORY_IMAGE_COPY* pRegions)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    recordCopyBufferImage(grCmdBuffer, CMD_COPY_IMAGE_TO_BUFFER, (GrGpuMemory*)destMem,
+                          (GrImage*)srcImage, regionCount, pRegions);
+}
+
+GR_VOID grCmdUpdateMemory(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY destMem,
+    GR_GPU_SIZE destOffset,
+    GR_GPU_SIZE dataSize,
+    const GR_UINT32* pData)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrGpuMemory* grGpuMemory = (GrGpuMemory*)destMem;
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceSize stagingOffset = 0;
+
+    // The data is only valid during the call, stage it right away. Unlike vkCmdUpdateBuffer,
+    // copying from a staging buffer isn't limited to 64KB.
+    void* data = allocStagingBuffer(grCmdBuffer->stagingBuffer, dataSize,
+                                    &stagingBuffer, &stagingOffset);
+    if (data == NULL) {
+        printf("%s: staging allocation failed\n", __func__);
+        return;
     }
 
-    vki.vkCmdDrawIndexed(grCmdBuffer->commandBuffer,
-                         indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+    memcpy(data, pData, dataSize);
+
+    VkBufferCopy* region = allocArena(grCmdBuffer->arena, sizeof(VkBufferCopy));
+    *region = (VkBufferCopy) {
+        .srcOffset = stagingOffset,
+        .dstOffset = destOffset,
+        .size = dataSize,
+    };
+
+    CmdEntry* entry = appendCopyEntry(grCmdBuffer, CMD_COPY_BUFFER, region);
+    entry->copy.srcBuffer = stagingBuffer;
+    entry->copy.dstBuffer = grGpuMemory->buffer;
+    entry->copy.regionCount = 1;
+}
+
+GR_VOID grCmdFillMemory(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_GPU_MEMORY destMem,
+    GR_GPU_SIZE destOffset,
+    GR_GPU_SIZE fillSize,
+    GR_UINT32 data)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrGpuMemory* grGpuMemory = (GrGpuMemory*)destMem;
+
+    CmdEntry* entry = appendCmdEntry(grCmdBuffer, CMD_FILL_BUFFER);
+    entry->fillBuffer.dstBuffer = grGpuMemory->buffer;
+    entry->fillBuffer.offset = destOffset;
+    entry->fillBuffer.size = fillSize;
+    entry->fillBuffer.data = data;
 }
 
 GR_VOID grCmdClearColorImage(
@@ -331,20 +2731,12 @@ GR_VOID grCmdClearColorImage(
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
     GrImage* grImage = (GrImage*)image;
 
-    const VkClearColorValue vkColor = {
-        .float32 = { color[0], color[1], color[2], color[3] },
+    const VkClearValue vkClearValue = {
+        .color.float32 = { color[0], color[1], color[2], color[3] },
     };
 
-    VkImageSubresourceRange* vkRanges = malloc(rangeCount * sizeof(VkImageSubresourceRange));
-    for (int i = 0; i < rangeCount; i++) {
-        vkRanges[i] = getVkImageSubresourceRange(&pRanges[i]);
-    }
-
-    vki.vkCmdClearColorImage(grCmdBuffer->commandBuffer, grImage->image,
-                             getVkImageLayout(GR_IMAGE_STATE_CLEAR),
-                             &vkColor, rangeCount, vkRanges);
-
-    free(vkRanges);
+    recordClearImage(grCmdBuffer, CMD_CLEAR_COLOR_IMAGE, grImage, &vkClearValue,
+                     rangeCount, pRanges);
 }
 
 GR_VOID grCmdClearColorImageRaw(
@@ -357,18 +2749,32 @@ GR_VOID grCmdClearColorImageRaw(
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
     GrImage* grImage = (GrImage*)image;
 
-    const VkClearColorValue vkColor = {
-        .uint32 = { color[0], color[1], color[2], color[3] },
+    const VkClearValue vkClearValue = {
+        .color.uint32 = { color[0], color[1], color[2], color[3] },
     };
 
-    VkImageSubresourceRange* vkRanges = malloc(rangeCount * sizeof(VkImageSubresourceRange));
-    for (int i = 0; i < rangeCount; i++) {
-        vkRanges[i] = getVkImageSubresourceRange(&pRanges[i]);
-    }
+    recordClearImage(grCmdBuffer, CMD_CLEAR_COLOR_IMAGE, grImage, &vkClearValue,
+                     rangeCount, pRanges);
+}
+
+GR_VOID grCmdClearDepthStencil(
+    GR_CMD_BUFFER cmdBuffer,
+    GR_IMAGE image,
+    GR_FLOAT depth,
+    GR_UINT8 stencil,
+    GR_UINT rangeCount,
+    const GR_IMAGE_SUBRESOURCE_RANGE* pRanges)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrImage* grImage = (GrImage*)image;
 
-    vki.vkCmdClearColorImage(grCmdBuffer->commandBuffer, grImage->image,
-                             getVkImageLayout(GR_IMAGE_STATE_CLEAR),
-                             &vkColor, rangeCount, vkRanges);
+    const VkClearValue vkClearValue = {
+        .depthStencil = {
+            .depth = depth,
+            .stencil = stencil,
+        },
+    };
 
-    free(vkRanges);
+    recordClearImage(grCmdBuffer, CMD_CLEAR_DEPTH_STENCIL, grImage, &vkClearValue,
+                     rangeCount, pRanges);
 }
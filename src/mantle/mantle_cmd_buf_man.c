@@ -1,5 +1,30 @@
 #include "mantle_internal.h"
 
+// Drops the recorded commands, the Vulkan command buffer is kept and gets reset implicitly when
+// recording is lowered again
+static void resetCmdBuffer(
+    GrCmdBuffer* grCmdBuffer)
+{
+    // The app waits for previous submissions to complete before recording again
+    if (grCmdBuffer->retiredCommandBuffer != VK_NULL_HANDLE) {
+        releaseCmdPoolCommandBuffer(grCmdBuffer->retiredCmdPool,
+                                    grCmdBuffer->retiredCommandBuffer);
+        grCmdBuffer->retiredCmdPool = NULL;
+        grCmdBuffer->retiredCommandBuffer = VK_NULL_HANDLE;
+    }
+
+    resetArena(grCmdBuffer->arena);
+    resetStagingBuffer(grCmdBuffer->stagingBuffer);
+    grCmdBuffer->usageFlags = 0;
+    grCmdBuffer->submitQueue = NULL;
+    grCmdBuffer->submitValue = 0;
+    grCmdBuffer->firstEntry = NULL;
+    grCmdBuffer->lastEntry = NULL;
+    grCmdBuffer->stats = (CmdBufferStats) {};
+
+    resetImageStateTracker(grCmdBuffer->imageStateTracker);
+}
+
 // Command Buffer Management Functions
 
 GR_RESULT grCreateCommandBuffer(
@@ -8,45 +33,58 @@ GR_RESULT grCreateCommandBuffer(
     GR_CMD_BUFFER* pCmdBuffer)
 {
     GrDevice* grDevice = (GrDevice*)device;
-    VkCommandPool vkCommandPool = VK_NULL_HANDLE;
-    VkCommandBuffer vkCommandBuffer = VK_NULL_HANDLE;
 
-    if (pCreateInfo->queueType == GR_QUEUE_UNIVERSAL) {
-        vkCommandPool = grDevice->universalCommandPool;
-    } else if (pCreateInfo->queueType == GR_QUEUE_COMPUTE) {
-        vkCommandPool = grDevice->computeCommandPool;
-    }
-
-    if (vkCommandPool == VK_NULL_HANDLE) {
+    // The Vulkan command buffer is allocated from the pool of the thread ending the recording
+    uint32_t queueFamilyIndex = getVkQueueFamilyIndex(grDevice, pCreateInfo->queueType);
+    if (queueFamilyIndex == INVALID_QUEUE_INDEX) {
         return GR_ERROR_INVALID_QUEUE_TYPE;
     }
 
-    const VkCommandBufferAllocateInfo allocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .pNext = NULL,
-        .commandPool = vkCommandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-
-    if (vki.vkAllocateCommandBuffers(grDevice->device, &allocateInfo,
-                                     &vkCommandBuffer) != VK_SUCCESS) {
-        printf("%s: vkAllocateCommandBuffers failed\n", __func__);
-        return GR_ERROR_OUT_OF_MEMORY;
-    }
-
     GrCmdBuffer* grCmdBuffer = malloc(sizeof(GrCmdBuffer));
     *grCmdBuffer = (GrCmdBuffer) {
         .sType = GR_STRUCT_TYPE_COMMAND_BUFFER,
-        .commandBuffer = vkCommandBuffer,
+        .grDevice = grDevice,
+        .queueFamilyIndex = queueFamilyIndex,
+        .cmdPool = NULL,
+        .commandBuffer = VK_NULL_HANDLE,
+        .usageFlags = 0,
+        .submitQueue = NULL,
+        .submitValue = 0,
+        .retiredCmdPool = NULL,
+        .retiredCommandBuffer = VK_NULL_HANDLE,
+        .arena = createArena(CMD_ARENA_CHUNK_SIZE),
+        .stagingBuffer = createStagingBuffer(grDevice->device, grDevice->physicalDevice,
+                                             CMD_STAGING_CHUNK_SIZE),
+        .firstEntry = NULL,
+        .lastEntry = NULL,
         .grPipeline = NULL,
         .grDescriptorSet = NULL,
+        .indexGrGpuMemory = NULL,
+        .indexOffset = 0,
+        .indexType = VK_INDEX_TYPE_UINT16,
+        .dynamicMemoryView = {},
         .colorTargets = {},
         .colorTargetCount = 0,
         .depthTarget = {},
         .hasDepthTarget = false,
         .hasActiveRenderPass = false,
-        .isDirty = false,
+        .renderPassFormats = {},
+        .renderPassExtent = { 0, 0 },
+        .pendingLoadOps = {},
+        .pendingLoadOpCount = 0,
+        .imageStateTracker = createImageStateTracker(),
+        .grViewportState = NULL,
+        .grRasterState = NULL,
+        .grDepthStencilState = NULL,
+        .grColorBlendState = NULL,
+        .dirtyStateFlags = 0,
+        .validDynamicStateFlags = 0,
+        .computeGrPipeline = NULL,
+        .computeGrDescriptorSet = NULL,
+        .computeDynamicMemoryView = {},
+        .computeDirtyStateFlags = 0,
+        .dynamicState = {},
+        .stats = {},
     };
 
     *pCmdBuffer = (GR_CMD_BUFFER)grCmdBuffer;
@@ -64,17 +102,9 @@ GR_RESULT grBeginCommandBuffer(
         vkUsageFlags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     }
 
-    const VkCommandBufferBeginInfo beginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = NULL,
-        .flags = vkUsageFlags,
-        .pInheritanceInfo = NULL,
-    };
-
-    if (vki.vkBeginCommandBuffer(grCmdBuffer->commandBuffer, &beginInfo) != VK_SUCCESS) {
-        printf("%s: vkBeginCommandBuffer failed\n", __func__);
-        return GR_ERROR_OUT_OF_MEMORY;
-    }
+    // Commands are recorded into the arena and lowered to Vulkan when recording ends
+    resetCmdBuffer(grCmdBuffer);
+    grCmdBuffer->usageFlags = vkUsageFlags;
 
     return GR_SUCCESS;
 }
@@ -83,15 +113,31 @@ GR_RESULT grEndCommandBuffer(
     GR_CMD_BUFFER cmdBuffer)
 {
     GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+    GrDevice* grDevice = grCmdBuffer->grDevice;
 
-    if (grCmdBuffer->hasActiveRenderPass) {
-        vki.vkCmdEndRenderPass(grCmdBuffer->commandBuffer);
+    grCmdBuffer->commandBuffer = getThreadVkCommandBuffer(grDevice->cmdPoolManager,
+                                                          grCmdBuffer->queueFamilyIndex,
+                                                          &grCmdBuffer->cmdPool,
+                                                          grCmdBuffer->commandBuffer);
+    if (grCmdBuffer->commandBuffer == VK_NULL_HANDLE) {
+        return GR_ERROR_OUT_OF_MEMORY;
     }
 
-    if (vki.vkEndCommandBuffer(grCmdBuffer->commandBuffer) != VK_SUCCESS) {
-        printf("%s: vkEndCommandBuffer failed\n", __func__);
-        return GR_ERROR_OUT_OF_MEMORY;
+    return lowerCmdBuffer(grCmdBuffer);
+}
+
+GR_RESULT grResetCommandBuffer(
+    GR_CMD_BUFFER cmdBuffer)
+{
+    GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)cmdBuffer;
+
+    if (grCmdBuffer == NULL) {
+        return GR_ERROR_INVALID_HANDLE;
+    } else if (grCmdBuffer->sType != GR_STRUCT_TYPE_COMMAND_BUFFER) {
+        return GR_ERROR_INVALID_OBJECT_TYPE;
     }
 
+    resetCmdBuffer(grCmdBuffer);
+
     return GR_SUCCESS;
 }
@@ -0,0 +1,44 @@
+#include "mantle_internal.h"
+
+static uint32_t mStatsDumpInterval = 0;
+static bool mIsStatsDumpIntervalSet = false;
+
+// Number of submissions between two queue stats dumps, 0 if disabled. Defaults to the
+// GRVK_STATS_DUMP_INTERVAL environment variable until the app sets the option.
+uint32_t getStatsDumpInterval()
+{
+    if (!mIsStatsDumpIntervalSet) {
+        const char* value = getenv("GRVK_STATS_DUMP_INTERVAL");
+
+        mStatsDumpInterval = value != NULL ? strtoul(value, NULL, 10) : 0;
+        mIsStatsDumpIntervalSet = true;
+    }
+
+    return mStatsDumpInterval;
+}
+
+// Debug Functions
+
+GR_RESULT grDbgSetGlobalOption(
+    GR_DBG_GLOBAL_OPTION dbgOption,
+    GR_SIZE dataSize,
+    const GR_VOID* pData)
+{
+    switch (dbgOption) {
+    case GR_DBG_OPTION_GRVK_STATS_DUMP_INTERVAL:
+        if (pData == NULL) {
+            return GR_ERROR_INVALID_POINTER;
+        } else if (dataSize != sizeof(GR_UINT)) {
+            return GR_ERROR_INVALID_MEMORY_SIZE;
+        }
+
+        mStatsDumpInterval = *(const GR_UINT*)pData;
+        mIsStatsDumpIntervalSet = true;
+        break;
+    default:
+        printf("%s: unsupported option 0x%X\n", __func__, dbgOption);
+        return GR_UNSUPPORTED;
+    }
+
+    return GR_SUCCESS;
+}
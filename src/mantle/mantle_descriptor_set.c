@@ -56,14 +56,14 @@ GR_RESULT grCreateDescriptorSet(
     // Create descriptor pool in a way that allows any type to fill all the requested slots
     const VkDescriptorPoolSize poolSize = {
         .type = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, // TODO support other types
-        .descriptorCount = MAX_STAGE_COUNT * pCreateInfo->slots,
+        .descriptorCount = DESCRIPTOR_SET_STAGE_COUNT * pCreateInfo->slots,
     };
 
     const VkDescriptorPoolCreateInfo poolCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .maxSets = MAX_STAGE_COUNT,
+        .maxSets = DESCRIPTOR_SET_STAGE_COUNT,
         .poolSizeCount = 1,
         .pPoolSizes = &poolSize,
     };
@@ -111,8 +111,8 @@ GR_VOID grEndDescriptorSetUpdate(
     // TODO free old descriptor sets and layouts if applicable
 
     uint32_t descriptorCount = 0;
-    VkDescriptorSetLayout vkLayouts[MAX_STAGE_COUNT];
-    for (int i = 0; i < MAX_STAGE_COUNT; i++) {
+    VkDescriptorSetLayout vkLayouts[DESCRIPTOR_SET_STAGE_COUNT];
+    for (int i = 0; i < DESCRIPTOR_SET_STAGE_COUNT; i++) {
         VkDescriptorSetLayoutBinding* bindings =
             malloc(sizeof(VkDescriptorSetLayoutBinding) * grDescriptorSet->slotCount);
 
@@ -177,7 +177,7 @@ GR_VOID grEndDescriptorSetUpdate(
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
         .pNext = NULL,
         .descriptorPool = grDescriptorSet->descriptorPool,
-        .descriptorSetCount = MAX_STAGE_COUNT,
+        .descriptorSetCount = DESCRIPTOR_SET_STAGE_COUNT,
         .pSetLayouts = vkLayouts,
     };
 
@@ -186,7 +186,7 @@ GR_VOID grEndDescriptorSetUpdate(
         printf("%s: vkAllocateDescriptorSets failed\n", __func__);
     }
 
-    for (int i = 0; i < MAX_STAGE_COUNT; i++) {
+    for (int i = 0; i < DESCRIPTOR_SET_STAGE_COUNT; i++) {
         for (int j = 0; j < grDescriptorSet->slotCount; j++) {
             const DescriptorSetSlot* slot = &((DescriptorSetSlot*)grDescriptorSet->slots)[j];
 
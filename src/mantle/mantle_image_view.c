@@ -1,5 +1,18 @@
 #include "mantle_internal.h"
 
+static VkExtent2D getMipLevelExtent(
+    const GrImage* grImage,
+    uint32_t mipLevel)
+{
+    uint32_t width = grImage->extent.width >> mipLevel;
+    uint32_t height = grImage->extent.height >> mipLevel;
+
+    return (VkExtent2D) {
+        .width = width > 0 ? width : 1,
+        .height = height > 0 ? height : 1,
+    };
+}
+
 // Image View Functions
 
 GR_RESULT grCreateColorTargetView(
@@ -8,15 +21,17 @@ GR_RESULT grCreateColorTargetView(
     GR_COLOR_TARGET_VIEW* pView)
 {
     GrDevice* grDevice = (GrDevice*)device;
+    GrImage* grImage = (GrImage*)pCreateInfo->image;
     VkImageView vkImageView = VK_NULL_HANDLE;
+    VkFormat vkFormat = getVkFormat(pCreateInfo->format);
 
     const VkImageViewCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .image = ((GrImage*)pCreateInfo->image)->image,
+        .image = grImage->image,
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = getVkFormat(pCreateInfo->format),
+        .format = vkFormat,
         .components = {
             .r = VK_COMPONENT_SWIZZLE_IDENTITY,
             .g = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -41,9 +56,65 @@ GR_RESULT grCreateColorTargetView(
     GrColorTargetView* grColorTargetView = malloc(sizeof(GrColorTargetView));
     *grColorTargetView = (GrColorTargetView) {
         .sType = GR_STRUCT_TYPE_COLOR_TARGET_VIEW,
+        .grDevice = grDevice,
+        .grImage = grImage,
         .imageView = vkImageView,
+        .format = vkFormat,
+        .extent = getMipLevelExtent(grImage, pCreateInfo->mipLevel),
     };
 
     *pView = (GR_COLOR_TARGET_VIEW)grColorTargetView;
     return GR_SUCCESS;
 }
+
+GR_RESULT grCreateDepthStencilView(
+    GR_DEVICE device,
+    const GR_DEPTH_STENCIL_VIEW_CREATE_INFO* pCreateInfo,
+    GR_DEPTH_STENCIL_VIEW* pView)
+{
+    GrDevice* grDevice = (GrDevice*)device;
+    GrImage* grImage = (GrImage*)pCreateInfo->image;
+    VkImageView vkImageView = VK_NULL_HANDLE;
+
+    // TODO handle read-only depth and stencil flags
+    const VkImageViewCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = grImage->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = grImage->format,
+        .components = {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+        },
+        .subresourceRange = {
+            .aspectMask = getVkDepthStencilAspectFlags(grImage->format),
+            .baseMipLevel = pCreateInfo->mipLevel,
+            .levelCount = 1,
+            .baseArrayLayer = pCreateInfo->baseArraySlice,
+            .layerCount = pCreateInfo->arraySize == GR_LAST_MIP_OR_SLICE ?
+                          VK_REMAINING_ARRAY_LAYERS : pCreateInfo->arraySize,
+        }
+    };
+
+    if (vki.vkCreateImageView(grDevice->device, &createInfo, NULL, &vkImageView) != VK_SUCCESS) {
+        printf("%s: vkCreateImageView failed\n", __func__);
+        return GR_ERROR_OUT_OF_MEMORY;
+    }
+
+    GrDepthStencilView* grDepthStencilView = malloc(sizeof(GrDepthStencilView));
+    *grDepthStencilView = (GrDepthStencilView) {
+        .sType = GR_STRUCT_TYPE_DEPTH_STENCIL_VIEW,
+        .grDevice = grDevice,
+        .grImage = grImage,
+        .imageView = vkImageView,
+        .format = grImage->format,
+        .extent = getMipLevelExtent(grImage, pCreateInfo->mipLevel),
+    };
+
+    *pView = (GR_DEPTH_STENCIL_VIEW)grDepthStencilView;
+    return GR_SUCCESS;
+}
@@ -84,6 +84,32 @@ GR_RESULT grInitAndEnumerateGpus(
     return GR_SUCCESS;
 }
 
+static bool isTimelineSemaphoreSupported(
+    VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceProperties properties;
+    vki.vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphore = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .pNext = NULL,
+        .timelineSemaphore = VK_FALSE,
+    };
+
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &timelineSemaphore,
+    };
+
+    vki.vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    return timelineSemaphore.timelineSemaphore;
+}
+
 GR_RESULT grCreateDevice(
     GR_PHYSICAL_GPU gpu,
     const GR_DEVICE_CREATE_INFO* pCreateInfo,
@@ -94,12 +120,12 @@ GR_RESULT grCreateDevice(
     VkDevice vkDevice = VK_NULL_HANDLE;
     uint32_t universalQueueIndex = INVALID_QUEUE_INDEX;
     uint32_t universalQueueCount = 0;
+    uint32_t universalQueueRequestedCount = 0;
     bool universalQueueRequested = false;
-    VkCommandPool universalCommandPool = VK_NULL_HANDLE;
     uint32_t computeQueueIndex = INVALID_QUEUE_INDEX;
     uint32_t computeQueueCount = 0;
+    uint32_t computeQueueRequestedCount = 0;
     bool computeQueueRequested = false;
-    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
 
     uint32_t queueFamilyPropertyCount = 0;
     vki.vkGetPhysicalDeviceQueueFamilyProperties(grPhysicalGpu->physicalDevice,
@@ -157,8 +183,10 @@ GR_RESULT grCreateDevice(
 
         if (requestedQueue->queueType == GR_QUEUE_UNIVERSAL) {
             universalQueueRequested = true;
+            universalQueueRequestedCount = requestedQueue->queueCount;
         } else if (requestedQueue->queueType == GR_QUEUE_COMPUTE) {
             computeQueueRequested = true;
+            computeQueueRequestedCount = requestedQueue->queueCount;
         }
     }
 
@@ -166,29 +194,50 @@ GR_RESULT grCreateDevice(
         goto bail;
     }
 
-    const VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicState = {
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicState = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
         .pNext = NULL,
         .extendedDynamicState = VK_TRUE,
     };
+    void* featuresChain = &extendedDynamicState;
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    VkPhysicalDeviceProperties properties;
+    vki.vkGetPhysicalDeviceFeatures(grPhysicalGpu->physicalDevice, &supportedFeatures);
+    vki.vkGetPhysicalDeviceProperties(grPhysicalGpu->physicalDevice, &properties);
 
     const VkPhysicalDeviceFeatures deviceFeatures = {
         .geometryShader = VK_TRUE,
         .tessellationShader = VK_TRUE,
         .dualSrcBlend = VK_TRUE,
         .logicOp = VK_TRUE,
+        .multiDrawIndirect = supportedFeatures.multiDrawIndirect,
         .depthClamp = VK_TRUE,
         .multiViewport = VK_TRUE,
     };
 
     const char *deviceExtensions[] = {
         VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME,
+        VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     };
 
+    // Track command buffer completion to know when resubmitting them requires a copy
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphore = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .pNext = featuresChain,
+        .timelineSemaphore = VK_TRUE,
+    };
+    bool useTimelineSemaphores = false;
+
+    if (isTimelineSemaphoreSupported(grPhysicalGpu->physicalDevice)) {
+        featuresChain = &timelineSemaphore;
+        useTimelineSemaphores = true;
+    }
+
     const VkDeviceCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pNext = &extendedDynamicState,
+        .pNext = featuresChain,
         .flags = 0,
         .queueCreateInfoCount = pCreateInfo->queueRecordCount,
         .pQueueCreateInfos = queueCreateInfos,
@@ -206,48 +255,43 @@ GR_RESULT grCreateDevice(
         goto bail;
     }
 
-    if (universalQueueRequested && universalQueueIndex != INVALID_QUEUE_INDEX) {
-        const VkCommandPoolCreateInfo poolCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-            .pNext = NULL,
-            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-            .queueFamilyIndex = universalQueueIndex,
-        };
-
-        if (vki.vkCreateCommandPool(vkDevice, &poolCreateInfo, NULL,
-                                    &universalCommandPool) != VK_SUCCESS) {
-            printf("%s: vkCreateCommandPool failed\n", __func__);
-            res = GR_ERROR_INITIALIZATION_FAILED;
-            goto bail;
-        }
-    }
-    if (computeQueueRequested && computeQueueIndex != INVALID_QUEUE_INDEX) {
-        const VkCommandPoolCreateInfo poolCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-            .pNext = NULL,
-            .flags = 0,
-            .queueFamilyIndex = computeQueueIndex,
-        };
-
-        if (vki.vkCreateCommandPool(vkDevice, &poolCreateInfo, NULL,
-                                    &computeCommandPool) != VK_SUCCESS) {
-            printf("%s: vkCreateCommandPool failed\n", __func__);
-            res = GR_ERROR_INITIALIZATION_FAILED;
-            goto bail;
-        }
-    }
-
     GrDevice* grDevice = malloc(sizeof(GrDevice));
     *grDevice = (GrDevice) {
         .sType = GR_STRUCT_TYPE_DEVICE,
         .device = vkDevice,
         .physicalDevice = grPhysicalGpu->physicalDevice,
-        .universalQueueIndex = universalQueueIndex,
-        .universalCommandPool = universalCommandPool,
-        .computeQueueIndex = computeQueueIndex,
-        .computeCommandPool = computeCommandPool,
+        .universalQueueIndex = universalQueueRequested ? universalQueueIndex : INVALID_QUEUE_INDEX,
+        .computeQueueIndex = computeQueueRequested ? computeQueueIndex : INVALID_QUEUE_INDEX,
+        .universalQueues = NULL,
+        .universalQueueCount = 0,
+        .computeQueues = NULL,
+        .computeQueueCount = 0,
+        .useTimelineSemaphores = useTimelineSemaphores,
+        .maxDrawIndirectCount = supportedFeatures.multiDrawIndirect ?
+                                properties.limits.maxDrawIndirectCount : 1,
+        .cmdPoolManager = createCmdPoolManager(vkDevice),
+        .renderPassCache = createRenderPassCache(vkDevice),
+        .framebufferCache = createFramebufferCache(vkDevice),
     };
 
+    // Queues are created once, grGetDeviceQueue returns the same object for each of them
+    res = createGrQueues(grDevice, universalQueueIndex, universalQueueRequestedCount,
+                         &grDevice->universalQueues);
+    if (res != GR_SUCCESS) {
+        free(grDevice);
+        goto bail;
+    }
+    grDevice->universalQueueCount = universalQueueRequestedCount;
+
+    res = createGrQueues(grDevice, computeQueueIndex, computeQueueRequestedCount,
+                         &grDevice->computeQueues);
+    if (res != GR_SUCCESS) {
+        destroyGrQueues(grDevice->universalQueues, grDevice->universalQueueCount);
+        free(grDevice);
+        goto bail;
+    }
+    grDevice->computeQueueCount = computeQueueRequestedCount;
+
     *pDevice = (GR_DEVICE)grDevice;
 
 bail:
@@ -257,12 +301,6 @@ bail:
     free(queueCreateInfos);
 
     if (res != GR_SUCCESS) {
-        if (universalCommandPool != VK_NULL_HANDLE) {
-            vki.vkDestroyCommandPool(vkDevice, universalCommandPool, NULL);
-        }
-        if (computeCommandPool != VK_NULL_HANDLE) {
-            vki.vkDestroyCommandPool(vkDevice, computeCommandPool, NULL);
-        }
         if (vkDevice != VK_NULL_HANDLE) {
             vki.vkDestroyDevice(vkDevice, NULL);
         }
@@ -270,3 +308,27 @@ bail:
 
     return res;
 }
+
+GR_RESULT grDestroyDevice(
+    GR_DEVICE device)
+{
+    GrDevice* grDevice = (GrDevice*)device;
+
+    if (grDevice == NULL) {
+        return GR_ERROR_INVALID_HANDLE;
+    } else if (grDevice->sType != GR_STRUCT_TYPE_DEVICE) {
+        return GR_ERROR_INVALID_OBJECT_TYPE;
+    }
+
+    vki.vkDeviceWaitIdle(grDevice->device);
+
+    destroyGrQueues(grDevice->universalQueues, grDevice->universalQueueCount);
+    destroyGrQueues(grDevice->computeQueues, grDevice->computeQueueCount);
+    destroyCmdPoolManager(grDevice->cmdPoolManager);
+    destroyFramebufferCache(grDevice->framebufferCache);
+    destroyRenderPassCache(grDevice->renderPassCache);
+    vki.vkDestroyDevice(grDevice->device, NULL);
+    free(grDevice);
+
+    return GR_SUCCESS;
+}
@@ -7,10 +7,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include "mantle/mantle.h"
+#include "mantle/mantleDbg.h"
 #include "mantle_object.h"
 #include "vulkan_loader.h"
 
 #define INVALID_QUEUE_INDEX -1u
+#define CMD_ARENA_CHUNK_SIZE (64 * 1024)
+#define QUEUE_ARENA_CHUNK_SIZE (4 * 1024)
+#define CMD_STAGING_CHUNK_SIZE (64 * 1024)
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
 
 GR_VOID* grAlloc(
     GR_SIZE size,
@@ -32,9 +39,21 @@ VkAccessFlags getVkAccessFlagsImage(
 VkAccessFlags getVkAccessFlagsMemory(
     GR_MEMORY_STATE memoryState);
 
+VkPipelineStageFlags getVkPipelineStageFlagsImage(
+    GR_IMAGE_STATE imageState);
+
+VkPipelineStageFlags getVkPipelineStageFlagsMemory(
+    GR_MEMORY_STATE memoryState);
+
 VkImageAspectFlags getVkImageAspectFlags(
     GR_IMAGE_ASPECT imageAspect);
 
+VkImageAspectFlags getVkDepthStencilAspectFlags(
+    VkFormat format);
+
+VkImageAspectFlags getVkFormatAspectFlags(
+    VkFormat format);
+
 VkSampleCountFlagBits getVkSampleCountFlagBits(
     GR_UINT samples);
 
@@ -77,4 +96,147 @@ VkShaderStageFlags getVkShaderStageFlags(
 VkPipelineBindPoint getVkPipelineBindPoint(
     GR_PIPELINE_BIND_POINT bindPoint);
 
+VkIndexType getVkIndexType(
+    GR_INDEX_TYPE indexType);
+
+uint32_t getVkQueueFamilyIndex(
+    GrDevice* grDevice,
+    GR_QUEUE_TYPE queueType);
+
+uint32_t getStatsDumpInterval();
+
+GR_RESULT createGrQueues(
+    GrDevice* grDevice,
+    uint32_t queueIndex,
+    uint32_t queueCount,
+    GrQueue** pQueues);
+
+void destroyGrQueues(
+    GrQueue* grQueues,
+    uint32_t queueCount);
+
+void getQueueStats(
+    const GrQueue* grQueue,
+    GR_DBG_GRVK_QUEUE_STATS* pStats);
+
+Arena* createArena(
+    size_t chunkSize);
+
+void destroyArena(
+    Arena* arena);
+
+void* allocArena(
+    Arena* arena,
+    size_t size);
+
+void resetArena(
+    Arena* arena);
+
+CmdPoolManager* createCmdPoolManager(
+    VkDevice device);
+
+void destroyCmdPoolManager(
+    CmdPoolManager* manager);
+
+CmdPool* getThreadCmdPool(
+    CmdPoolManager* manager,
+    uint32_t queueFamilyIndex);
+
+VkCommandBuffer getThreadVkCommandBuffer(
+    CmdPoolManager* manager,
+    uint32_t queueFamilyIndex,
+    CmdPool** pCmdPool,
+    VkCommandBuffer commandBuffer);
+
+void releaseCmdPoolCommandBuffer(
+    CmdPool* cmdPool,
+    VkCommandBuffer commandBuffer);
+
+GR_RESULT lowerCmdBuffer(
+    GrCmdBuffer* grCmdBuffer);
+
+StagingBuffer* createStagingBuffer(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkDeviceSize chunkSize);
+
+void destroyStagingBuffer(
+    StagingBuffer* stagingBuffer);
+
+void* allocStagingBuffer(
+    StagingBuffer* stagingBuffer,
+    VkDeviceSize size,
+    VkBuffer* pBuffer,
+    VkDeviceSize* pOffset);
+
+void resetStagingBuffer(
+    StagingBuffer* stagingBuffer);
+
+RenderPassCache* createRenderPassCache(
+    VkDevice device);
+
+void destroyRenderPassCache(
+    RenderPassCache* cache);
+
+VkRenderPass getCachedVkRenderPass(
+    RenderPassCache* cache,
+    const AttachmentFormats* pFormats,
+    const AttachmentOps* pOps);
+
+void getRenderPassCacheStats(
+    RenderPassCache* cache,
+    uint64_t* pHitCount,
+    uint64_t* pMissCount);
+
+FramebufferCache* createFramebufferCache(
+    VkDevice device);
+
+void destroyFramebufferCache(
+    FramebufferCache* cache);
+
+VkFramebuffer getCachedVkFramebuffer(
+    FramebufferCache* cache,
+    VkRenderPass renderPass,
+    uint32_t attachmentCount,
+    const VkImageView* pAttachments,
+    const VkFormat* pFormats,
+    VkExtent2D extent);
+
+void invalidateFramebufferCacheView(
+    FramebufferCache* cache,
+    VkImageView imageView);
+
+void getFramebufferCacheStats(
+    FramebufferCache* cache,
+    uint64_t* pHitCount,
+    uint64_t* pMissCount);
+
+ImageStateTracker* createImageStateTracker();
+
+void destroyImageStateTracker(
+    ImageStateTracker* tracker);
+
+void resetImageStateTracker(
+    ImageStateTracker* tracker);
+
+bool updateImageState(
+    ImageStateTracker* tracker,
+    GrImage* grImage,
+    const VkImageSubresourceRange* range,
+    GR_IMAGE_STATE oldState,
+    GR_IMAGE_STATE newState);
+
+VkImageLayout getImageStateLayout(
+    const ImageStateTracker* tracker,
+    const GrImage* grImage,
+    VkImageAspectFlags aspectMask,
+    uint32_t mipLevel,
+    uint32_t arrayLayer);
+
+void commitImageStates(
+    ImageStateTracker* tracker);
+
+VkImageLayout* createImageLayouts(
+    const GrImage* grImage);
+
 #endif // MANTLE_INTERNAL_H_
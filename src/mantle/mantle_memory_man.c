@@ -121,7 +121,12 @@ GR_RESULT grAllocMemory(
         .pNext = NULL,
         .flags = 0,
         .size = pAllocInfo->size,
-        .usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT, // FIXME incomplete
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                 VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT |
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, // FIXME incomplete
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
         .pQueueFamilyIndices = NULL,
@@ -6,12 +6,18 @@
 #include "vulkan/vulkan.h"
 
 #define MAX_STAGE_COUNT 5 // VS, HS, DS, GS, PS
+#define COMPUTE_STAGE_INDEX MAX_STAGE_COUNT // CS, only used for descriptor sets
+#define DESCRIPTOR_SET_STAGE_COUNT (MAX_STAGE_COUNT + 1)
+#define DYNAMIC_MEMORY_VIEW_SET_INDEX MAX_STAGE_COUNT // Push descriptor set after the stage sets
+#define COMPUTE_DYNAMIC_MEMORY_VIEW_SET_INDEX 1 // Push descriptor set after the CS set
+#define MAX_PENDING_LOAD_OP_COUNT (2 * (GR_MAX_COLOR_TARGETS + 1))
 
 typedef enum _GrStructType {
     GR_STRUCT_TYPE_COMMAND_BUFFER,
     GR_STRUCT_TYPE_COLOR_BLEND_STATE_OBJECT,
     GR_STRUCT_TYPE_COLOR_TARGET_VIEW,
     GR_STRUCT_TYPE_DEPTH_STENCIL_STATE_OBJECT,
+    GR_STRUCT_TYPE_DEPTH_STENCIL_VIEW,
     GR_STRUCT_TYPE_DESCRIPTOR_SET,
     GR_STRUCT_TYPE_DEVICE,
     GR_STRUCT_TYPE_FENCE,
@@ -26,25 +32,177 @@ typedef enum _GrStructType {
     GR_STRUCT_TYPE_VIEWPORT_STATE_OBJECT,
 } GrStructType;
 
+typedef struct _GrColorBlendStateObject GrColorBlendStateObject;
+typedef struct _GrDepthStencilStateObject GrDepthStencilStateObject;
 typedef struct _GrDescriptorSet GrDescriptorSet;
+typedef struct _GrDevice GrDevice;
+typedef struct _GrGpuMemory GrGpuMemory;
+typedef struct _GrImage GrImage;
 typedef struct _GrPipeline GrPipeline;
+typedef struct _GrQueue GrQueue;
+typedef struct _GrRasterStateObject GrRasterStateObject;
+typedef struct _GrViewportStateObject GrViewportStateObject;
+typedef struct _Arena Arena;
+typedef struct _CmdEntry CmdEntry;
+typedef struct _CmdPool CmdPool;
+typedef struct _CmdPoolManager CmdPoolManager;
+typedef struct _FramebufferCache FramebufferCache;
+typedef struct _ImageStateTracker ImageStateTracker;
+typedef struct _RenderPassCache RenderPassCache;
+typedef struct _StagingBuffer StagingBuffer;
 
 // Generic object used to read the object type
 typedef struct _GrObject {
     GrStructType sType;
 } GrObject;
 
+typedef enum _DynamicStateBit {
+    DYNAMIC_STATE_VIEWPORT = 1 << 0,
+    DYNAMIC_STATE_SCISSOR = 1 << 1,
+    DYNAMIC_STATE_CULL_MODE = 1 << 2,
+    DYNAMIC_STATE_FRONT_FACE = 1 << 3,
+    DYNAMIC_STATE_DEPTH_BIAS = 1 << 4,
+    DYNAMIC_STATE_DEPTH_TEST_ENABLE = 1 << 5,
+    DYNAMIC_STATE_DEPTH_WRITE_ENABLE = 1 << 6,
+    DYNAMIC_STATE_DEPTH_COMPARE_OP = 1 << 7,
+    DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE = 1 << 8,
+    DYNAMIC_STATE_STENCIL_TEST_ENABLE = 1 << 9,
+    DYNAMIC_STATE_STENCIL_OP_FRONT = 1 << 10,
+    DYNAMIC_STATE_STENCIL_OP_BACK = 1 << 11,
+    DYNAMIC_STATE_STENCIL_COMPARE_MASK_FRONT = 1 << 12,
+    DYNAMIC_STATE_STENCIL_COMPARE_MASK_BACK = 1 << 13,
+    DYNAMIC_STATE_STENCIL_WRITE_MASK_FRONT = 1 << 14,
+    DYNAMIC_STATE_STENCIL_WRITE_MASK_BACK = 1 << 15,
+    DYNAMIC_STATE_STENCIL_REFERENCE_FRONT = 1 << 16,
+    DYNAMIC_STATE_STENCIL_REFERENCE_BACK = 1 << 17,
+    DYNAMIC_STATE_DEPTH_BOUNDS = 1 << 18,
+    DYNAMIC_STATE_BLEND_CONSTANTS = 1 << 19,
+} DynamicStateBit;
+
+typedef enum _DirtyStateBit {
+    DIRTY_STATE_VIEWPORT = 1 << 0,
+    DIRTY_STATE_RASTER = 1 << 1,
+    DIRTY_STATE_DEPTH_STENCIL = 1 << 2,
+    DIRTY_STATE_COLOR_BLEND = 1 << 3,
+    DIRTY_STATE_PIPELINE = 1 << 4,
+    DIRTY_STATE_DESCRIPTOR_SET = 1 << 5,
+    DIRTY_STATE_TARGETS = 1 << 6,
+    DIRTY_STATE_INDEX_DATA = 1 << 7,
+    DIRTY_STATE_DYNAMIC_MEMORY_VIEW = 1 << 8,
+} DirtyStateBit;
+
+#define DIRTY_STATE_DYNAMIC_MASK \
+    (DIRTY_STATE_VIEWPORT | DIRTY_STATE_RASTER | DIRTY_STATE_DEPTH_STENCIL | DIRTY_STATE_COLOR_BLEND)
+#define DIRTY_STATE_RESOURCE_MASK \
+    (DIRTY_STATE_PIPELINE | DIRTY_STATE_DESCRIPTOR_SET | DIRTY_STATE_TARGETS | \
+     DIRTY_STATE_INDEX_DATA | DIRTY_STATE_DYNAMIC_MEMORY_VIEW)
+
+// Attachment formats, which determine render pass compatibility
+typedef struct _AttachmentFormats {
+    uint32_t colorFormatCount;
+    VkFormat colorFormats[GR_MAX_COLOR_TARGETS];
+    VkFormat depthStencilFormat;
+} AttachmentFormats;
+
+// Attachment operations, which only affect how a render pass begins and ends
+typedef struct _AttachmentOps {
+    VkAttachmentLoadOp colorLoadOps[GR_MAX_COLOR_TARGETS];
+    VkAttachmentStoreOp colorStoreOps[GR_MAX_COLOR_TARGETS];
+    VkAttachmentLoadOp depthLoadOp;
+    VkAttachmentStoreOp depthStoreOp;
+    VkAttachmentLoadOp stencilLoadOp;
+    VkAttachmentStoreOp stencilStoreOp;
+} AttachmentOps;
+
+// Load op for the next render pass using the image, either a folded clear or contents that don't
+// need to be loaded
+typedef struct _PendingLoadOp {
+    VkImage image;
+    VkImageAspectFlags aspectMask;
+    VkAttachmentLoadOp loadOp;
+    VkClearValue clearValue;
+} PendingLoadOp;
+
+// Last dynamic state emitted to the Vulkan command buffer
+typedef struct _DynamicState {
+    VkViewport viewports[GR_MAX_VIEWPORTS];
+    uint32_t viewportCount;
+    VkRect2D scissors[GR_MAX_VIEWPORTS];
+    uint32_t scissorCount;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    float depthBiasConstantFactor;
+    float depthBiasClamp;
+    float depthBiasSlopeFactor;
+    VkBool32 depthTestEnable;
+    VkBool32 depthWriteEnable;
+    VkCompareOp depthCompareOp;
+    VkBool32 depthBoundsTestEnable;
+    VkBool32 stencilTestEnable;
+    VkStencilOpState front;
+    VkStencilOpState back;
+    float minDepthBounds;
+    float maxDepthBounds;
+    float blendConstants[4];
+} DynamicState;
+
+typedef struct _CmdBufferStats {
+    uint64_t drawCallCount;
+    uint64_t dispatchCallCount;
+    uint64_t bindCallCount;
+    uint64_t skippedBindCount; // Recorded binds that didn't need any Vulkan call
+    uint64_t dynamicStateCallCount;
+    uint64_t skippedDynamicStateCallCount;
+    uint64_t barrierCallCount;
+    uint64_t renderPassBeginCount;
+    uint64_t mergedIndirectCallCount; // Indirect draw calls emitting several merged draws
+    uint64_t mergedIndirectDrawCount; // Draws emitted as part of a merged indirect call
+    uint64_t mergedTransferCount; // Copies and fills folded into a previous one
+} CmdBufferStats;
+
 typedef struct _GrCmdBuffer {
     GrStructType sType;
+    GrDevice* grDevice;
+    uint32_t queueFamilyIndex;
+    CmdPool* cmdPool;
     VkCommandBuffer commandBuffer;
+    VkCommandBufferUsageFlags usageFlags;
+    GrQueue* submitQueue; // Last submission since recording
+    uint64_t submitValue;
+    CmdPool* retiredCmdPool; // Copied command buffer possibly still in use
+    VkCommandBuffer retiredCommandBuffer;
+    Arena* arena;
+    StagingBuffer* stagingBuffer;
+    CmdEntry* firstEntry;
+    CmdEntry* lastEntry;
     GrPipeline* grPipeline;
     GrDescriptorSet* grDescriptorSet;
+    GrGpuMemory* indexGrGpuMemory;
+    VkDeviceSize indexOffset;
+    VkIndexType indexType;
+    VkDescriptorBufferInfo dynamicMemoryView;
     GR_COLOR_TARGET_BIND_INFO colorTargets[GR_MAX_COLOR_TARGETS];
     uint32_t colorTargetCount;
     GR_DEPTH_STENCIL_BIND_INFO depthTarget;
     bool hasDepthTarget;
     bool hasActiveRenderPass;
-    bool isDirty;
+    AttachmentFormats renderPassFormats;
+    VkExtent2D renderPassExtent;
+    PendingLoadOp pendingLoadOps[MAX_PENDING_LOAD_OP_COUNT];
+    uint32_t pendingLoadOpCount;
+    ImageStateTracker* imageStateTracker;
+    GrViewportStateObject* grViewportState;
+    GrRasterStateObject* grRasterState;
+    GrDepthStencilStateObject* grDepthStencilState;
+    GrColorBlendStateObject* grColorBlendState;
+    uint32_t dirtyStateFlags;
+    uint32_t validDynamicStateFlags;
+    GrPipeline* computeGrPipeline;
+    GrDescriptorSet* computeGrDescriptorSet;
+    VkDescriptorBufferInfo computeDynamicMemoryView;
+    uint32_t computeDirtyStateFlags;
+    DynamicState dynamicState;
+    CmdBufferStats stats;
 } GrCmdBuffer;
 
 typedef struct _GrColorBlendStateObject {
@@ -54,7 +212,11 @@ typedef struct _GrColorBlendStateObject {
 
 typedef struct _GrColorTargetView {
     GrStructType sType;
+    GrDevice* grDevice;
+    GrImage* grImage;
     VkImageView imageView;
+    VkFormat format;
+    VkExtent2D extent;
 } GrColorTargetView;
 
 typedef struct _GrDepthStencilStateObject {
@@ -70,13 +232,22 @@ typedef struct _GrDepthStencilStateObject {
     float maxDepthBounds;
 } GrDepthStencilStateObject;
 
+typedef struct _GrDepthStencilView {
+    GrStructType sType;
+    GrDevice* grDevice;
+    GrImage* grImage;
+    VkImageView imageView;
+    VkFormat format;
+    VkExtent2D extent;
+} GrDepthStencilView;
+
 typedef struct _GrDescriptorSet {
     GrStructType sType;
     VkDevice device;
     VkDescriptorPool descriptorPool;
     void* slots;
     uint32_t slotCount;
-    VkDescriptorSet descriptorSets[MAX_STAGE_COUNT];
+    VkDescriptorSet descriptorSets[DESCRIPTOR_SET_STAGE_COUNT];
 } GrDescriptorSet;
 
 typedef struct _GrDevice {
@@ -84,9 +255,16 @@ typedef struct _GrDevice {
     VkDevice device;
     VkPhysicalDevice physicalDevice;
     uint32_t universalQueueIndex;
-    VkCommandPool universalCommandPool;
     uint32_t computeQueueIndex;
-    VkCommandPool computeCommandPool;
+    GrQueue* universalQueues;
+    uint32_t universalQueueCount;
+    GrQueue* computeQueues;
+    uint32_t computeQueueCount;
+    bool useTimelineSemaphores;
+    uint32_t maxDrawIndirectCount;
+    CmdPoolManager* cmdPoolManager;
+    RenderPassCache* renderPassCache;
+    FramebufferCache* framebufferCache;
 } GrDevice;
 
 typedef struct _GrFence {
@@ -104,6 +282,12 @@ typedef struct _GrGpuMemory {
 typedef struct _GrImage {
     GrStructType sType;
     VkImage image;
+    VkFormat format;
+    VkExtent3D extent;
+    uint32_t mipLevels;
+    uint32_t arrayLayers;
+    VkSampleCountFlagBits samples;
+    VkImageLayout* layouts; // Last known layout of each subresource
 } GrImage;
 
 typedef struct _GrMsaaStateObject {
@@ -120,6 +304,8 @@ typedef struct _GrPipeline {
     VkPipelineLayout pipelineLayout;
     VkPipeline pipeline;
     VkRenderPass renderPass;
+    AttachmentFormats attachmentFormats;
+    bool hasDynamicMemoryView;
 } GrPipeline;
 
 typedef struct _GrRasterStateObject {
@@ -141,6 +327,11 @@ typedef struct _GrQueue {
     GrDevice* grDevice;
     VkQueue queue;
     uint32_t queueIndex;
+    VkSemaphore timelineSemaphore; // Signaled with the submission count
+    Arena* scratchArena;
+    uint64_t submitCount;
+    uint64_t cmdBufferCount;
+    CmdBufferStats stats; // Sum of all submitted command buffers
 } GrQueue;
 
 typedef struct _GrViewportStateObject {
@@ -2,6 +2,55 @@
 
 // Generic API Object Management functions
 
+GR_RESULT grDestroyObject(
+    GR_OBJECT object)
+{
+    GrObject* grObject = (GrObject*)object;
+
+    if (grObject == NULL) {
+        return GR_ERROR_INVALID_HANDLE;
+    }
+
+    switch (grObject->sType) {
+    case GR_STRUCT_TYPE_COMMAND_BUFFER: {
+        GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)grObject;
+
+        // The Vulkan command buffer goes back to its pool to be recycled
+        if (grCmdBuffer->commandBuffer != VK_NULL_HANDLE) {
+            releaseCmdPoolCommandBuffer(grCmdBuffer->cmdPool, grCmdBuffer->commandBuffer);
+        }
+        if (grCmdBuffer->retiredCommandBuffer != VK_NULL_HANDLE) {
+            releaseCmdPoolCommandBuffer(grCmdBuffer->retiredCmdPool,
+                                        grCmdBuffer->retiredCommandBuffer);
+        }
+        destroyArena(grCmdBuffer->arena);
+        destroyStagingBuffer(grCmdBuffer->stagingBuffer);
+        destroyImageStateTracker(grCmdBuffer->imageStateTracker);
+    }   break;
+    case GR_STRUCT_TYPE_COLOR_TARGET_VIEW: {
+        GrColorTargetView* grColorTargetView = (GrColorTargetView*)grObject;
+        GrDevice* grDevice = grColorTargetView->grDevice;
+
+        invalidateFramebufferCacheView(grDevice->framebufferCache, grColorTargetView->imageView);
+        vki.vkDestroyImageView(grDevice->device, grColorTargetView->imageView, NULL);
+    }   break;
+    case GR_STRUCT_TYPE_DEPTH_STENCIL_VIEW: {
+        GrDepthStencilView* grDepthStencilView = (GrDepthStencilView*)grObject;
+        GrDevice* grDevice = grDepthStencilView->grDevice;
+
+        invalidateFramebufferCacheView(grDevice->framebufferCache, grDepthStencilView->imageView);
+        vki.vkDestroyImageView(grDevice->device, grDepthStencilView->imageView, NULL);
+    }   break;
+    default:
+        // TODO
+        printf("%s: unsupported object type %d\n", __func__, grObject->sType);
+        return GR_UNSUPPORTED;
+    }
+
+    free(grObject);
+    return GR_SUCCESS;
+}
+
 GR_RESULT grGetObjectInfo(
     GR_BASE_OBJECT object,
     GR_ENUM infoType,
@@ -39,6 +88,18 @@ GR_RESULT grGetObjectInfo(
             return GR_ERROR_INVALID_VALUE;
         }
     }   break;
+    case GR_DBG_DATA_GRVK_QUEUE_STATS:
+        if (pData == NULL) {
+            *pDataSize = sizeof(GR_DBG_GRVK_QUEUE_STATS);
+            return GR_SUCCESS;
+        } else if (*pDataSize != sizeof(GR_DBG_GRVK_QUEUE_STATS)) {
+            return GR_ERROR_INVALID_MEMORY_SIZE;
+        } else if (grObject->sType != GR_STRUCT_TYPE_QUEUE) {
+            return GR_ERROR_INVALID_OBJECT_TYPE;
+        }
+
+        getQueueStats((GrQueue*)grObject, (GR_DBG_GRVK_QUEUE_STATS*)pData);
+        break;
     default:
         printf("%s: unsupported info type 0x%X\n", __func__, infoType);
         return GR_ERROR_INVALID_VALUE;
@@ -1,5 +1,7 @@
 #include "mantle_internal.h"
 
+#define MAX_STACK_FENCE_COUNT 16
+
 // Query and Synchronization Functions
 
 GR_RESULT grCreateFence(
@@ -54,7 +56,10 @@ GR_RESULT grWaitForFences(
         return GR_ERROR_INVALID_POINTER;
     }
 
-    VkFence* vkFences = malloc(sizeof(VkFence) * fenceCount);
+    // Waits are usually on a handful of fences, avoid hitting the heap for those
+    VkFence stackFences[MAX_STACK_FENCE_COUNT];
+    VkFence* vkFences = fenceCount <= MAX_STACK_FENCE_COUNT ?
+                        stackFences : malloc(sizeof(VkFence) * fenceCount);
     for (int i = 0; i < fenceCount; i++) {
         GrFence* grFence = (GrFence*)pFences[i];
 
@@ -62,7 +67,9 @@ GR_RESULT grWaitForFences(
     }
 
     res = vki.vkWaitForFences(grDevice->device, fenceCount, vkFences, waitAll, vkTimeout);
-    free(vkFences);
+    if (vkFences != stackFences) {
+        free(vkFences);
+    }
 
     if (res == VK_SUCCESS) {
         return GR_SUCCESS;
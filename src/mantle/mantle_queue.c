@@ -1,50 +1,272 @@
+#include <inttypes.h>
 #include "mantle_internal.h"
 
-static uint32_t getVkQueueFamilyIndex(
-    GrDevice* grDevice,
-    GR_QUEUE_TYPE queueType)
+static void addCmdBufferStats(
+    CmdBufferStats* stats,
+    const CmdBufferStats* other)
 {
-    switch (queueType) {
-    case GR_QUEUE_UNIVERSAL:
-        return grDevice->universalQueueIndex;
-    case GR_QUEUE_COMPUTE:
-        return grDevice->computeQueueIndex;
-    }
+    stats->drawCallCount += other->drawCallCount;
+    stats->dispatchCallCount += other->dispatchCallCount;
+    stats->bindCallCount += other->bindCallCount;
+    stats->skippedBindCount += other->skippedBindCount;
+    stats->dynamicStateCallCount += other->dynamicStateCallCount;
+    stats->skippedDynamicStateCallCount += other->skippedDynamicStateCallCount;
+    stats->barrierCallCount += other->barrierCallCount;
+    stats->renderPassBeginCount += other->renderPassBeginCount;
+    stats->mergedIndirectCallCount += other->mergedIndirectCallCount;
+    stats->mergedIndirectDrawCount += other->mergedIndirectDrawCount;
+    stats->mergedTransferCount += other->mergedTransferCount;
+}
+
+static void dumpQueueStats(
+    const GrQueue* grQueue)
+{
+    GR_DBG_GRVK_QUEUE_STATS stats;
 
-    printf("%s: invalid queue type %d\n", __func__, queueType);
-    return INVALID_QUEUE_INDEX;
+    getQueueStats(grQueue, &stats);
+
+    printf("queue %p: %" PRIu64 " submits, %" PRIu64 " command buffers\n",
+           grQueue, stats.submitCount, stats.cmdBufferCount);
+    printf("  %" PRIu64 " draws (%" PRIu64 " merged indirect calls of %" PRIu64 " draws), "
+           "%" PRIu64 " dispatches\n",
+           stats.drawCallCount, stats.mergedIndirectCallCount, stats.mergedIndirectDrawCount,
+           stats.dispatchCallCount);
+    printf("  %" PRIu64 " binds (%" PRIu64 " skipped), "
+           "%" PRIu64 " dynamic states (%" PRIu64 " skipped)\n",
+           stats.bindCallCount, stats.skippedBindCount,
+           stats.dynamicStateCallCount, stats.skippedDynamicStateCallCount);
+    printf("  %" PRIu64 " barriers, %" PRIu64 " render pass begins, "
+           "%" PRIu64 " merged transfers\n",
+           stats.barrierCallCount, stats.renderPassBeginCount, stats.mergedTransferCount);
+    printf("  %" PRIu64 " render passes (%" PRIu64 " cache hits), "
+           "%" PRIu64 " framebuffers (%" PRIu64 " cache hits)\n",
+           stats.renderPassCreateCount, stats.renderPassCacheHitCount,
+           stats.framebufferCreateCount, stats.framebufferCacheHitCount);
 }
 
-// Queue Functions
+// Checks whether the last submission of the command buffer may still be executing
+static bool isCmdBufferPending(
+    const GrCmdBuffer* grCmdBuffer)
+{
+    const GrQueue* grQueue = grCmdBuffer->submitQueue;
+    uint64_t value = 0;
 
-GR_RESULT grGetDeviceQueue(
-    GR_DEVICE device,
-    GR_ENUM queueType,
-    GR_UINT queueId,
-    GR_QUEUE* pQueue)
+    if (grQueue == NULL) {
+        return false;
+    } else if (grQueue->timelineSemaphore == VK_NULL_HANDLE) {
+        return true;
+    }
+
+    if (vki.vkGetSemaphoreCounterValue(grQueue->grDevice->device, grQueue->timelineSemaphore,
+                                       &value) != VK_SUCCESS) {
+        printf("%s: vkGetSemaphoreCounterValue failed\n", __func__);
+        return true;
+    }
+
+    return value < grCmdBuffer->submitValue;
+}
+
+// Makes a submitted command buffer valid to submit again. Unless it allows simultaneous use, the
+// commands are lowered again to a copy which does, and the pending one is released on reset.
+static GR_RESULT prepareCmdBufferResubmit(
+    GrCmdBuffer* grCmdBuffer)
 {
-    GrDevice* grDevice = (GrDevice*)device;
-    VkQueue vkQueue = VK_NULL_HANDLE;
+    GrDevice* grDevice = grCmdBuffer->grDevice;
+    bool isOneTimeSubmit = (grCmdBuffer->usageFlags &
+                            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != 0;
+    bool isPending = isCmdBufferPending(grCmdBuffer);
+
+    if ((grCmdBuffer->usageFlags & VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT) != 0 ||
+        (!isOneTimeSubmit && !isPending)) {
+        return GR_SUCCESS;
+    }
+
+    if (isPending) {
+        if (grCmdBuffer->retiredCommandBuffer != VK_NULL_HANDLE) {
+            releaseCmdPoolCommandBuffer(grCmdBuffer->retiredCmdPool,
+                                        grCmdBuffer->retiredCommandBuffer);
+        }
+
+        grCmdBuffer->retiredCmdPool = grCmdBuffer->cmdPool;
+        grCmdBuffer->retiredCommandBuffer = grCmdBuffer->commandBuffer;
+        grCmdBuffer->cmdPool = NULL;
+        grCmdBuffer->commandBuffer = VK_NULL_HANDLE;
+    }
 
-    uint32_t queueIndex = getVkQueueFamilyIndex(grDevice, queueType);
-    if (queueIndex == INVALID_QUEUE_INDEX) {
-        return GR_ERROR_INVALID_QUEUE_TYPE;
+    // Reuses the current command buffer if it's idle and owned by the calling thread
+    grCmdBuffer->commandBuffer = getThreadVkCommandBuffer(grDevice->cmdPoolManager,
+                                                          grCmdBuffer->queueFamilyIndex,
+                                                          &grCmdBuffer->cmdPool,
+                                                          grCmdBuffer->commandBuffer);
+    if (grCmdBuffer->commandBuffer == VK_NULL_HANDLE) {
+        return GR_ERROR_OUT_OF_MEMORY;
     }
 
+    // Further submissions won't need another copy
+    grCmdBuffer->usageFlags = (grCmdBuffer->usageFlags &
+                               ~VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) |
+                              VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+
+    // Lowering is done once per recording as far as stats are concerned
+    CmdBufferStats stats = grCmdBuffer->stats;
+    GR_RESULT res = lowerCmdBuffer(grCmdBuffer);
+    grCmdBuffer->stats = stats;
+
+    return res;
+}
+
+void getQueueStats(
+    const GrQueue* grQueue,
+    GR_DBG_GRVK_QUEUE_STATS* pStats)
+{
+    const CmdBufferStats* stats = &grQueue->stats;
+    GrDevice* grDevice = grQueue->grDevice;
+    uint64_t renderPassHitCount, renderPassMissCount;
+    uint64_t framebufferHitCount, framebufferMissCount;
+
+    getRenderPassCacheStats(grDevice->renderPassCache, &renderPassHitCount, &renderPassMissCount);
+    getFramebufferCacheStats(grDevice->framebufferCache,
+                             &framebufferHitCount, &framebufferMissCount);
+
+    *pStats = (GR_DBG_GRVK_QUEUE_STATS) {
+        .submitCount = grQueue->submitCount,
+        .cmdBufferCount = grQueue->cmdBufferCount,
+        .drawCallCount = stats->drawCallCount,
+        .dispatchCallCount = stats->dispatchCallCount,
+        .bindCallCount = stats->bindCallCount,
+        .skippedBindCount = stats->skippedBindCount,
+        .dynamicStateCallCount = stats->dynamicStateCallCount,
+        .skippedDynamicStateCallCount = stats->skippedDynamicStateCallCount,
+        .barrierCallCount = stats->barrierCallCount,
+        .renderPassBeginCount = stats->renderPassBeginCount,
+        .mergedIndirectCallCount = stats->mergedIndirectCallCount,
+        .mergedIndirectDrawCount = stats->mergedIndirectDrawCount,
+        .mergedTransferCount = stats->mergedTransferCount,
+        .renderPassCreateCount = renderPassMissCount,
+        .renderPassCacheHitCount = renderPassHitCount,
+        .framebufferCreateCount = framebufferMissCount,
+        .framebufferCacheHitCount = framebufferHitCount,
+    };
+}
+
+static GR_RESULT initGrQueue(
+    GrQueue* grQueue,
+    GrDevice* grDevice,
+    uint32_t queueIndex,
+    uint32_t queueId)
+{
+    VkQueue vkQueue = VK_NULL_HANDLE;
+    VkSemaphore vkTimelineSemaphore = VK_NULL_HANDLE;
+
     vki.vkGetDeviceQueue(grDevice->device, queueIndex, queueId, &vkQueue);
 
-    GrQueue* grQueue = malloc(sizeof(GrQueue));
+    if (grDevice->useTimelineSemaphores) {
+        const VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .pNext = NULL,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        };
+
+        const VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &semaphoreTypeCreateInfo,
+            .flags = 0,
+        };
+
+        if (vki.vkCreateSemaphore(grDevice->device, &semaphoreCreateInfo, NULL,
+                                  &vkTimelineSemaphore) != VK_SUCCESS) {
+            printf("%s: vkCreateSemaphore failed\n", __func__);
+            return GR_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
     *grQueue = (GrQueue) {
         .sType = GR_STRUCT_TYPE_QUEUE,
         .grDevice = grDevice,
         .queue = vkQueue,
         .queueIndex = queueIndex,
+        .timelineSemaphore = vkTimelineSemaphore,
+        .scratchArena = createArena(QUEUE_ARENA_CHUNK_SIZE),
+        .submitCount = 0,
+        .cmdBufferCount = 0,
+        .stats = {},
     };
 
-    *pQueue = (GR_QUEUE)grQueue;
     return GR_SUCCESS;
 }
 
+static void destroyGrQueue(
+    GrQueue* grQueue)
+{
+    vki.vkDestroySemaphore(grQueue->grDevice->device, grQueue->timelineSemaphore, NULL);
+    destroyArena(grQueue->scratchArena);
+}
+
+// Creates the queues of a family once at device creation, so that every grGetDeviceQueue call
+// for the same queue shares its submission tracking and stats
+GR_RESULT createGrQueues(
+    GrDevice* grDevice,
+    uint32_t queueIndex,
+    uint32_t queueCount,
+    GrQueue** pQueues)
+{
+    GrQueue* grQueues = malloc(sizeof(GrQueue) * queueCount);
+
+    for (int i = 0; i < queueCount; i++) {
+        GR_RESULT res = initGrQueue(&grQueues[i], grDevice, queueIndex, i);
+
+        if (res != GR_SUCCESS) {
+            destroyGrQueues(grQueues, i);
+            return res;
+        }
+    }
+
+    *pQueues = grQueues;
+    return GR_SUCCESS;
+}
+
+void destroyGrQueues(
+    GrQueue* grQueues,
+    uint32_t queueCount)
+{
+    for (int i = 0; i < queueCount; i++) {
+        destroyGrQueue(&grQueues[i]);
+    }
+
+    free(grQueues);
+}
+
+// Queue Functions
+
+GR_RESULT grGetDeviceQueue(
+    GR_DEVICE device,
+    GR_ENUM queueType,
+    GR_UINT queueId,
+    GR_QUEUE* pQueue)
+{
+    GrDevice* grDevice = (GrDevice*)device;
+
+    switch ((GR_QUEUE_TYPE)queueType) {
+    case GR_QUEUE_UNIVERSAL:
+        if (queueId >= grDevice->universalQueueCount) {
+            return GR_ERROR_INVALID_ORDINAL;
+        }
+
+        *pQueue = (GR_QUEUE)&grDevice->universalQueues[queueId];
+        return GR_SUCCESS;
+    case GR_QUEUE_COMPUTE:
+        if (queueId >= grDevice->computeQueueCount) {
+            return GR_ERROR_INVALID_ORDINAL;
+        }
+
+        *pQueue = (GR_QUEUE)&grDevice->computeQueues[queueId];
+        return GR_SUCCESS;
+    }
+
+    return GR_ERROR_INVALID_QUEUE_TYPE;
+}
+
 GR_RESULT grQueueSubmit(
     GR_QUEUE queue,
     GR_UINT cmdBufferCount,
@@ -57,6 +279,7 @@ GR_RESULT grQueueSubmit(
     GrFence* grFence = (GrFence*)fence;
     VkResult res;
     VkFence vkFence = VK_NULL_HANDLE;
+    uint64_t signalValue = grQueue->submitCount + 1;
 
     if (grFence != NULL) {
         vkFence = grFence->fence;
@@ -67,30 +290,70 @@ GR_RESULT grQueueSubmit(
         }
     }
 
-    VkCommandBuffer* vkCommandBuffers = malloc(sizeof(VkCommandBuffer) * cmdBufferCount);
+    // Handle arrays only live for the duration of the submission
+    resetArena(grQueue->scratchArena);
+
+    VkCommandBuffer* vkCommandBuffers = allocArena(grQueue->scratchArena,
+                                                   sizeof(VkCommandBuffer) * cmdBufferCount);
     for (int i = 0; i < cmdBufferCount; i++) {
-        vkCommandBuffers[i] = ((GrCmdBuffer*)pCmdBuffers[i])->commandBuffer;
+        GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)pCmdBuffers[i];
+
+        if (grCmdBuffer->submitQueue != NULL) {
+            GR_RESULT grRes = prepareCmdBufferResubmit(grCmdBuffer);
+            if (grRes != GR_SUCCESS) {
+                return grRes;
+            }
+        }
+
+        vkCommandBuffers[i] = grCmdBuffer->commandBuffer;
+        commitImageStates(grCmdBuffer->imageStateTracker);
+        addCmdBufferStats(&grQueue->stats, &grCmdBuffer->stats);
     }
 
+    bool hasTimelineSemaphore = grQueue->timelineSemaphore != VK_NULL_HANDLE;
+
+    const VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreValueCount = 0,
+        .pWaitSemaphoreValues = NULL,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &signalValue,
+    };
+
     const VkSubmitInfo submitInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = NULL,
+        .pNext = hasTimelineSemaphore ? &timelineSubmitInfo : NULL,
         .waitSemaphoreCount = 0,
         .pWaitSemaphores = NULL,
         .pWaitDstStageMask = NULL,
         .commandBufferCount = cmdBufferCount,
         .pCommandBuffers = vkCommandBuffers,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = NULL,
+        .signalSemaphoreCount = hasTimelineSemaphore ? 1 : 0,
+        .pSignalSemaphores = &grQueue->timelineSemaphore,
     };
 
     res = vki.vkQueueSubmit(grQueue->queue, 1, &submitInfo, vkFence);
-    free(vkCommandBuffers);
 
     if (res != VK_SUCCESS) {
         printf("%s: vkQueueSubmit failed\n", __func__);
         return GR_ERROR_OUT_OF_MEMORY;
     }
 
+    for (int i = 0; i < cmdBufferCount; i++) {
+        GrCmdBuffer* grCmdBuffer = (GrCmdBuffer*)pCmdBuffers[i];
+
+        grCmdBuffer->submitQueue = grQueue;
+        grCmdBuffer->submitValue = signalValue;
+    }
+
+    grQueue->submitCount++;
+    grQueue->cmdBufferCount += cmdBufferCount;
+
+    uint32_t statsDumpInterval = getStatsDumpInterval();
+    if (statsDumpInterval > 0 && grQueue->submitCount % statsDumpInterval == 0) {
+        dumpQueueStats(grQueue);
+    }
+
     return GR_SUCCESS;
 }
@@ -85,16 +85,51 @@ static VkDescriptorSetLayout getVkDescriptorSetLayout(
     return layout;
 }
 
+// The dynamic memory view is shared by all stages, it's pushed as a storage buffer so that
+// changing it between draws doesn't touch any descriptor set
+static VkDescriptorSetLayout getDynamicMemoryViewSetLayout(
+    const VkDevice vkDevice,
+    VkShaderStageFlags stageFlags)
+{
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+
+    const VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = stageFlags,
+        .pImmutableSamplers = NULL,
+    };
+
+    const VkDescriptorSetLayoutCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+
+    if (vki.vkCreateDescriptorSetLayout(vkDevice, &createInfo, NULL, &layout) != VK_SUCCESS) {
+        printf("%s: vkCreateDescriptorSetLayout failed\n", __func__);
+    }
+
+    return layout;
+}
+
+// The dynamic memory view set comes right after the stage sets
 static VkPipelineLayout getVkPipelineLayout(
     const VkDevice vkDevice,
-    const Stage* stages)
+    uint32_t stageCount,
+    const Stage* stages,
+    VkShaderStageFlags dynamicMemoryViewStageFlags)
 {
     VkPipelineLayout layout = VK_NULL_HANDLE;
+    uint32_t setLayoutCount = stageCount;
 
     // One descriptor set layout per stage, with an empty layout for each unused stage
-    VkDescriptorSetLayout descriptorSetLayouts[MAX_STAGE_COUNT];
+    VkDescriptorSetLayout descriptorSetLayouts[MAX_STAGE_COUNT + 1];
 
-    for (int i = 0; i < MAX_STAGE_COUNT; i++) {
+    for (int i = 0; i < stageCount; i++) {
         const Stage* stage = &stages[i];
 
         VkDescriptorSetLayout layout = getVkDescriptorSetLayout(vkDevice, stage);
@@ -110,11 +145,26 @@ static VkPipelineLayout getVkPipelineLayout(
         descriptorSetLayouts[i] = layout;
     }
 
+    if (dynamicMemoryViewStageFlags != 0) {
+        VkDescriptorSetLayout layout =
+            getDynamicMemoryViewSetLayout(vkDevice, dynamicMemoryViewStageFlags);
+
+        if (layout == VK_NULL_HANDLE) {
+            for (int i = 0; i < stageCount; i++) {
+                vki.vkDestroyDescriptorSetLayout(vkDevice, descriptorSetLayouts[i], NULL);
+            }
+            return VK_NULL_HANDLE;
+        }
+
+        descriptorSetLayouts[stageCount] = layout;
+        setLayoutCount++;
+    }
+
     const VkPipelineLayoutCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .setLayoutCount = MAX_STAGE_COUNT,
+        .setLayoutCount = setLayoutCount,
         .pSetLayouts = descriptorSetLayouts,
         .pushConstantRangeCount = 0,
         .pPushConstantRanges = NULL,
@@ -122,7 +172,7 @@ static VkPipelineLayout getVkPipelineLayout(
 
     if (vki.vkCreatePipelineLayout(vkDevice, &createInfo, NULL, &layout) != VK_SUCCESS) {
         printf("%s: vkCreatePipelineLayout failed\n", __func__);
-        for (int i = 0; i < MAX_STAGE_COUNT; i++) {
+        for (int i = 0; i < setLayoutCount; i++) {
             vki.vkDestroyDescriptorSetLayout(vkDevice, descriptorSetLayouts[i], NULL);
         }
     }
@@ -130,123 +180,28 @@ static VkPipelineLayout getVkPipelineLayout(
     return layout;
 }
 
-static VkRenderPass getVkRenderPass(
-    const VkDevice vkDevice,
+static AttachmentFormats getAttachmentFormats(
     const GR_PIPELINE_CB_TARGET_STATE* cbTargets,
     const GR_PIPELINE_DB_STATE* dbTarget)
 {
-    VkRenderPass renderPass = VK_NULL_HANDLE;
-    VkAttachmentDescription descriptions[GR_MAX_COLOR_TARGETS + 1];
-    VkAttachmentReference colorReferences[GR_MAX_COLOR_TARGETS];
-    VkAttachmentReference depthStencilReference;
-    uint32_t descriptionIdx = 0;
-    uint32_t colorReferenceIdx = 0;
-    bool hasDepthStencil = false;
+    AttachmentFormats attachmentFormats = {
+        .colorFormatCount = 0,
+        .colorFormats = { VK_FORMAT_UNDEFINED },
+        .depthStencilFormat = getVkFormat(dbTarget->format),
+    };
 
     for (int i = 0; i < GR_MAX_COLOR_TARGETS; i++) {
-        const GR_PIPELINE_CB_TARGET_STATE* target = &cbTargets[i];
-        VkFormat vkFormat = getVkFormat(target->format);
+        VkFormat vkFormat = getVkFormat(cbTargets[i].format);
 
         if (vkFormat == VK_FORMAT_UNDEFINED) {
             continue;
         }
 
-        descriptions[descriptionIdx] = (VkAttachmentDescription) {
-            .flags = 0,
-            .format = vkFormat,
-            .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
-            .storeOp = (target->channelWriteMask & 0xF) != 0 ?
-                       VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        };
-
-        colorReferences[colorReferenceIdx] = (VkAttachmentReference) {
-            .attachment = descriptionIdx,
-            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        };
-
-        descriptionIdx++;
-        colorReferenceIdx++;
+        attachmentFormats.colorFormats[attachmentFormats.colorFormatCount] = vkFormat;
+        attachmentFormats.colorFormatCount++;
     }
 
-    VkFormat dbVkFormat = getVkFormat(dbTarget->format);
-    if (dbVkFormat != VK_FORMAT_UNDEFINED) {
-        // Table 10 in the API reference
-        bool hasDepth = dbTarget->format.channelFormat == GR_CH_FMT_R16 ||
-                        dbTarget->format.channelFormat == GR_CH_FMT_R32 ||
-                        dbTarget->format.channelFormat == GR_CH_FMT_R16G8 ||
-                        dbTarget->format.channelFormat == GR_CH_FMT_R32G8;
-        bool hasStencil = dbTarget->format.channelFormat == GR_CH_FMT_R8 ||
-                          dbTarget->format.channelFormat == GR_CH_FMT_R16G8 ||
-                          dbTarget->format.channelFormat == GR_CH_FMT_R32G8;
-
-        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
-        if (hasDepth && hasStencil) {
-            layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-        } else if (hasDepth && !hasStencil) {
-            layout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-        } else if (!hasDepth && hasStencil) {
-            layout = VK_IMAGE_LAYOUT_STENCIL_ATTACHMENT_OPTIMAL;
-        }
-
-        descriptions[descriptionIdx] = (VkAttachmentDescription) {
-            .flags = 0,
-            .format = dbVkFormat,
-            .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = hasDepth ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .storeOp = hasDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .stencilLoadOp = hasStencil ?
-                             VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .stencilStoreOp = hasStencil ?
-                             VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = layout,
-            .finalLayout = layout,
-        };
-
-        depthStencilReference = (VkAttachmentReference) {
-            .attachment = descriptionIdx,
-            .layout = layout,
-        };
-
-        descriptionIdx++;
-        hasDepthStencil = true;
-    }
-
-    const VkSubpassDescription subpass = {
-        .flags = 0,
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .inputAttachmentCount = 0,
-        .pInputAttachments = NULL,
-        .colorAttachmentCount = colorReferenceIdx,
-        .pColorAttachments = colorReferences,
-        .pResolveAttachments = NULL,
-        .pDepthStencilAttachment = hasDepthStencil ? &depthStencilReference : NULL,
-        .preserveAttachmentCount = 0,
-        .pPreserveAttachments = NULL,
-    };
-
-    const VkRenderPassCreateInfo renderPassCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .attachmentCount = descriptionIdx,
-        .pAttachments = descriptions,
-        .subpassCount = 1,
-        .pSubpasses = &subpass,
-        .dependencyCount = 0,
-        .pDependencies = NULL,
-    };
-
-    if (vki.vkCreateRenderPass(vkDevice, &renderPassCreateInfo, NULL, &renderPass) != VK_SUCCESS) {
-        printf("%s: vkCreateRenderPass failed\n", __func__);
-        return VK_NULL_HANDLE;
-    }
-
-    return renderPass;
+    return attachmentFormats;
 }
 
 // Shader and Pipeline Functions
@@ -318,6 +273,7 @@ GR_RESULT grCreateGraphicsPipeline(
     }
 
     VkPipelineShaderStageCreateInfo shaderStageCreateInfo[MAX_STAGE_COUNT];
+    VkShaderStageFlags dynamicMemoryViewStageFlags = 0;
 
     // Fill in the info array
     uint32_t stageIndex = 0;
@@ -334,8 +290,7 @@ GR_RESULT grCreateGraphicsPipeline(
         }
 
         if (stage->shader->dynamicMemoryViewMapping.slotObjectType != GR_SLOT_UNUSED) {
-            // TODO implement
-            printf("%s: dynamic memory view mapping is not implemented\n", __func__);
+            dynamicMemoryViewStageFlags |= stage->flags;
         }
 
         GrShader* grShader = (GrShader*)stage->shader->shader;
@@ -525,13 +480,17 @@ GR_RESULT grCreateGraphicsPipeline(
         .pDynamicStates = dynamicStates,
     };
 
-    VkPipelineLayout layout = getVkPipelineLayout(grDevice->device, stages);
+    VkPipelineLayout layout = getVkPipelineLayout(grDevice->device, MAX_STAGE_COUNT, stages,
+                                                  dynamicMemoryViewStageFlags);
     if (layout == VK_NULL_HANDLE) {
         return GR_ERROR_OUT_OF_MEMORY;
     }
 
-    VkRenderPass renderPass = getVkRenderPass(grDevice->device,
-                                              pCreateInfo->cbState.target, &pCreateInfo->dbState);
+    // Load and store ops don't affect render pass compatibility, any cached variant works
+    AttachmentFormats attachmentFormats = getAttachmentFormats(pCreateInfo->cbState.target,
+                                                               &pCreateInfo->dbState);
+    VkRenderPass renderPass = getCachedVkRenderPass(grDevice->renderPassCache,
+                                                    &attachmentFormats, NULL);
     if (renderPass == VK_NULL_HANDLE)
     {
         vki.vkDestroyPipelineLayout(grDevice->device, layout, NULL);
@@ -567,7 +526,6 @@ GR_RESULT grCreateGraphicsPipeline(
                                       NULL, &vkPipeline) != VK_SUCCESS) {
         printf("%s: vkCreateGraphicsPipelines failed\n", __func__);
         vki.vkDestroyPipelineLayout(grDevice->device, layout, NULL);
-        vki.vkDestroyRenderPass(grDevice->device, renderPass, NULL);
         return GR_ERROR_OUT_OF_MEMORY;
     }
 
@@ -577,6 +535,81 @@ GR_RESULT grCreateGraphicsPipeline(
         .pipelineLayout = layout,
         .pipeline = vkPipeline,
         .renderPass = renderPass,
+        .attachmentFormats = attachmentFormats,
+        .hasDynamicMemoryView = dynamicMemoryViewStageFlags != 0,
+    };
+
+    *pPipeline = (GR_PIPELINE)grPipeline;
+    return GR_SUCCESS;
+}
+
+GR_RESULT grCreateComputePipeline(
+    GR_DEVICE device,
+    const GR_COMPUTE_PIPELINE_CREATE_INFO* pCreateInfo,
+    GR_PIPELINE* pPipeline)
+{
+    GrDevice* grDevice = (GrDevice*)device;
+    GrShader* grShader = (GrShader*)pCreateInfo->cs.shader;
+    VkShaderStageFlags dynamicMemoryViewStageFlags = 0;
+
+    // FIXME entry point is guessed
+    const Stage stage = { &pCreateInfo->cs, "CShader", VK_SHADER_STAGE_COMPUTE_BIT };
+
+    if (grShader == NULL) {
+        return GR_ERROR_INVALID_HANDLE;
+    }
+
+    if (pCreateInfo->cs.linkConstBufferCount > 0) {
+        // TODO implement
+        printf("%s: link-time constant buffers are not implemented\n", __func__);
+    }
+
+    if (pCreateInfo->cs.dynamicMemoryViewMapping.slotObjectType != GR_SLOT_UNUSED) {
+        dynamicMemoryViewStageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkPipelineLayout layout = getVkPipelineLayout(grDevice->device, 1, &stage,
+                                                  dynamicMemoryViewStageFlags);
+    if (layout == VK_NULL_HANDLE) {
+        return GR_ERROR_OUT_OF_MEMORY;
+    }
+
+    VkPipeline vkPipeline = VK_NULL_HANDLE;
+
+    const VkComputePipelineCreateInfo pipelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = (pCreateInfo->flags & GR_PIPELINE_CREATE_DISABLE_OPTIMIZATION) != 0 ?
+                 VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT : 0,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .stage = stage.flags,
+            .module = grShader->shaderModule,
+            .pName = stage.entryPoint,
+            .pSpecializationInfo = NULL,
+        },
+        .layout = layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1,
+    };
+
+    if (vki.vkCreateComputePipelines(grDevice->device, VK_NULL_HANDLE, 1, &pipelineCreateInfo,
+                                     NULL, &vkPipeline) != VK_SUCCESS) {
+        printf("%s: vkCreateComputePipelines failed\n", __func__);
+        vki.vkDestroyPipelineLayout(grDevice->device, layout, NULL);
+        return GR_ERROR_OUT_OF_MEMORY;
+    }
+
+    GrPipeline* grPipeline = malloc(sizeof(GrPipeline));
+    *grPipeline = (GrPipeline) {
+        .sType = GR_STRUCT_TYPE_PIPELINE,
+        .pipelineLayout = layout,
+        .pipeline = vkPipeline,
+        .renderPass = VK_NULL_HANDLE,
+        .attachmentFormats = {},
+        .hasDynamicMemoryView = dynamicMemoryViewStageFlags != 0,
     };
 
     *pPipeline = (GR_PIPELINE)grPipeline;
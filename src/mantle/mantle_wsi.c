@@ -6,6 +6,7 @@ static VkSurfaceKHR mSurface = VK_NULL_HANDLE;
 static VkSwapchainKHR mSwapchain = VK_NULL_HANDLE;
 static uint32_t mImageCount = 0;
 static VkImage* mImages;
+static CmdPool* mCopyCmdPool = NULL;
 static VkCommandBuffer mCopyCommandBuffer = VK_NULL_HANDLE;
 static VkSemaphore mAcquireSemaphore = VK_NULL_HANDLE;
 static VkSemaphore mCopySemaphore = VK_NULL_HANDLE;
@@ -68,20 +69,6 @@ static void initSwapchain(
     mImages = malloc(sizeof(VkImage) * mImageCount);
     vki.vkGetSwapchainImagesKHR(grDevice->device, mSwapchain, &mImageCount, mImages);
 
-    const VkCommandBufferAllocateInfo allocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .pNext = NULL,
-        .commandPool = grDevice->universalCommandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-
-    if (vki.vkAllocateCommandBuffers(grDevice->device, &allocateInfo,
-                                     &mCopyCommandBuffer) != VK_SUCCESS) {
-        printf("%s: vkAllocateCommandBuffers failed\n", __func__);
-        return;
-    }
-
     const VkSemaphoreCreateInfo semaphoreCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
         .pNext = NULL,
@@ -110,8 +97,8 @@ static void buildCopyCommandBuffer(
     const VkImageMemoryBarrier preCopyBarrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .pNext = NULL,
-        .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .srcAccessMask = 0,
+        .dstAccessMask = getVkAccessFlagsImage(GR_IMAGE_STATE_DATA_TRANSFER_DESTINATION),
         .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -126,9 +113,10 @@ static void buildCopyCommandBuffer(
         }
     };
 
+    // Chains with the acquire semaphore wait, which happens at the transfer stage
     vki.vkCmdPipelineBarrier(mCopyCommandBuffer,
-                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
-                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             getVkPipelineStageFlagsImage(GR_IMAGE_STATE_DATA_TRANSFER_DESTINATION),
                              0, 0, NULL, 0, NULL, 1, &preCopyBarrier);
 
     const VkImageBlit region = {
@@ -158,8 +146,8 @@ static void buildCopyCommandBuffer(
     const VkImageMemoryBarrier postCopyBarrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .pNext = NULL,
-        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .srcAccessMask = getVkAccessFlagsImage(GR_IMAGE_STATE_DATA_TRANSFER_DESTINATION),
+        .dstAccessMask = 0,
         .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -174,9 +162,10 @@ static void buildCopyCommandBuffer(
         }
     };
 
+    // Presentation waits on the copy semaphore, no further stages need to be blocked
     vki.vkCmdPipelineBarrier(mCopyCommandBuffer,
-                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
-                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // TODO optimize
+                             getVkPipelineStageFlagsImage(GR_IMAGE_STATE_DATA_TRANSFER_DESTINATION),
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
                              0, 0, NULL, 0, NULL, 1, &postCopyBarrier);
 
     if (vki.vkEndCommandBuffer(mCopyCommandBuffer) != VK_SUCCESS) {
@@ -249,8 +238,16 @@ GR_RESULT grWsiWinCreatePresentableImage(
     *grImage = (GrImage) {
         .sType = GR_STRUCT_TYPE_IMAGE,
         .image = vkImage,
+        .format = createInfo.format,
+        .extent = createInfo.extent,
+        .mipLevels = createInfo.mipLevels,
+        .arrayLayers = createInfo.arrayLayers,
+        .samples = createInfo.samples,
+        .layouts = NULL,
     };
 
+    grImage->layouts = createImageLayouts(grImage);
+
     GrGpuMemory* grGpuMemory = malloc(sizeof(GrGpuMemory));
     *grGpuMemory = (GrGpuMemory) {
         .sType = GR_STRUCT_TYPE_GPU_MEMORY,
@@ -282,6 +279,13 @@ GR_RESULT grWsiWinQueuePresent(
         return GR_ERROR_OUT_OF_MEMORY;
     }
 
+    mCopyCommandBuffer = getThreadVkCommandBuffer(grQueue->grDevice->cmdPoolManager,
+                                                  grQueue->queueIndex, &mCopyCmdPool,
+                                                  mCopyCommandBuffer);
+    if (mCopyCommandBuffer == VK_NULL_HANDLE) {
+        return GR_ERROR_OUT_OF_MEMORY;
+    }
+
     buildCopyCommandBuffer(srcGrImage->image, mImages[imageIndex]);
 
     VkPipelineStageFlagBits stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
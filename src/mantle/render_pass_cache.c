@@ -0,0 +1,252 @@
+#include "mantle_internal.h"
+
+#define RENDER_PASS_CACHE_BUCKET_COUNT 64
+
+typedef struct _RenderPassKey {
+    AttachmentFormats formats;
+    AttachmentOps ops;
+} RenderPassKey;
+
+typedef struct _RenderPassEntry {
+    struct _RenderPassEntry* next;
+    RenderPassKey key;
+    VkRenderPass renderPass;
+} RenderPassEntry;
+
+// Render passes only differ by their attachment formats and ops, so a handful of them is
+// shared by all pipelines and command buffers of the device
+struct _RenderPassCache {
+    VkDevice device;
+    CRITICAL_SECTION lock;
+    RenderPassEntry* buckets[RENDER_PASS_CACHE_BUCKET_COUNT];
+    uint64_t hitCount;
+    uint64_t missCount;
+};
+
+static uint32_t hashRenderPassKey(
+    const RenderPassKey* key)
+{
+    // FNV-1a
+    const uint8_t* data = (const uint8_t*)key;
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < sizeof(RenderPassKey); i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static VkImageLayout getDepthStencilLayout(
+    VkImageAspectFlags aspectMask)
+{
+    if (aspectMask == VK_IMAGE_ASPECT_DEPTH_BIT) {
+        return VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+    } else if (aspectMask == VK_IMAGE_ASPECT_STENCIL_BIT) {
+        return VK_IMAGE_LAYOUT_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+
+    return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+}
+
+static VkRenderPass createVkRenderPass(
+    VkDevice vkDevice,
+    const RenderPassKey* key)
+{
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkAttachmentDescription descriptions[GR_MAX_COLOR_TARGETS + 1];
+    VkAttachmentReference colorReferences[GR_MAX_COLOR_TARGETS];
+    VkAttachmentReference depthStencilReference;
+    uint32_t descriptionIdx = 0;
+    bool hasDepthStencil = false;
+
+    for (int i = 0; i < key->formats.colorFormatCount; i++) {
+        descriptions[descriptionIdx] = (VkAttachmentDescription) {
+            .flags = 0,
+            .format = key->formats.colorFormats[i],
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = key->ops.colorLoadOps[i],
+            .storeOp = key->ops.colorStoreOps[i],
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        };
+
+        colorReferences[i] = (VkAttachmentReference) {
+            .attachment = descriptionIdx,
+            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        };
+
+        descriptionIdx++;
+    }
+
+    if (key->formats.depthStencilFormat != VK_FORMAT_UNDEFINED) {
+        VkImageAspectFlags aspectMask =
+            getVkDepthStencilAspectFlags(key->formats.depthStencilFormat);
+        bool hasDepth = (aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+        bool hasStencil = (aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+        VkImageLayout layout = getDepthStencilLayout(aspectMask);
+
+        descriptions[descriptionIdx] = (VkAttachmentDescription) {
+            .flags = 0,
+            .format = key->formats.depthStencilFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = hasDepth ? key->ops.depthLoadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .storeOp = hasDepth ? key->ops.depthStoreOp : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = hasStencil ? key->ops.stencilLoadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = hasStencil ?
+                              key->ops.stencilStoreOp : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = layout,
+            .finalLayout = layout,
+        };
+
+        depthStencilReference = (VkAttachmentReference) {
+            .attachment = descriptionIdx,
+            .layout = layout,
+        };
+
+        descriptionIdx++;
+        hasDepthStencil = true;
+    }
+
+    const VkSubpassDescription subpass = {
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = NULL,
+        .colorAttachmentCount = key->formats.colorFormatCount,
+        .pColorAttachments = colorReferences,
+        .pResolveAttachments = NULL,
+        .pDepthStencilAttachment = hasDepthStencil ? &depthStencilReference : NULL,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = NULL,
+    };
+
+    const VkRenderPassCreateInfo renderPassCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .attachmentCount = descriptionIdx,
+        .pAttachments = descriptions,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 0,
+        .pDependencies = NULL,
+    };
+
+    if (vki.vkCreateRenderPass(vkDevice, &renderPassCreateInfo, NULL, &renderPass) != VK_SUCCESS) {
+        printf("%s: vkCreateRenderPass failed\n", __func__);
+        return VK_NULL_HANDLE;
+    }
+
+    return renderPass;
+}
+
+RenderPassCache* createRenderPassCache(
+    VkDevice device)
+{
+    RenderPassCache* cache = malloc(sizeof(RenderPassCache));
+    *cache = (RenderPassCache) {
+        .device = device,
+        .buckets = { NULL },
+        .hitCount = 0,
+        .missCount = 0,
+    };
+
+    InitializeCriticalSection(&cache->lock);
+
+    return cache;
+}
+
+void destroyRenderPassCache(
+    RenderPassCache* cache)
+{
+    for (int i = 0; i < RENDER_PASS_CACHE_BUCKET_COUNT; i++) {
+        RenderPassEntry* entry = cache->buckets[i];
+
+        while (entry != NULL) {
+            RenderPassEntry* next = entry->next;
+
+            vki.vkDestroyRenderPass(cache->device, entry->renderPass, NULL);
+            free(entry);
+            entry = next;
+        }
+    }
+
+    DeleteCriticalSection(&cache->lock);
+    free(cache);
+}
+
+// Passing NULL ops loads and stores every attachment
+VkRenderPass getCachedVkRenderPass(
+    RenderPassCache* cache,
+    const AttachmentFormats* pFormats,
+    const AttachmentOps* pOps)
+{
+    RenderPassKey key;
+
+    // Zero out padding and unused slots so the key can be hashed and compared bytewise
+    memset(&key, 0, sizeof(key));
+    key.formats.colorFormatCount = pFormats->colorFormatCount;
+    memcpy(key.formats.colorFormats, pFormats->colorFormats,
+           sizeof(VkFormat) * pFormats->colorFormatCount);
+    key.formats.depthStencilFormat = pFormats->depthStencilFormat;
+
+    // Unused slots are left to LOAD_OP_LOAD and STORE_OP_STORE, which are zero
+    if (pOps != NULL) {
+        memcpy(key.ops.colorLoadOps, pOps->colorLoadOps,
+               sizeof(VkAttachmentLoadOp) * pFormats->colorFormatCount);
+        memcpy(key.ops.colorStoreOps, pOps->colorStoreOps,
+               sizeof(VkAttachmentStoreOp) * pFormats->colorFormatCount);
+
+        if (pFormats->depthStencilFormat != VK_FORMAT_UNDEFINED) {
+            key.ops.depthLoadOp = pOps->depthLoadOp;
+            key.ops.depthStoreOp = pOps->depthStoreOp;
+            key.ops.stencilLoadOp = pOps->stencilLoadOp;
+            key.ops.stencilStoreOp = pOps->stencilStoreOp;
+        }
+    }
+
+    uint32_t bucketIdx = hashRenderPassKey(&key) % RENDER_PASS_CACHE_BUCKET_COUNT;
+
+    EnterCriticalSection(&cache->lock);
+
+    for (RenderPassEntry* entry = cache->buckets[bucketIdx]; entry != NULL; entry = entry->next) {
+        if (memcmp(&entry->key, &key, sizeof(key)) == 0) {
+            cache->hitCount++;
+            LeaveCriticalSection(&cache->lock);
+            return entry->renderPass;
+        }
+    }
+
+    VkRenderPass renderPass = createVkRenderPass(cache->device, &key);
+    if (renderPass == VK_NULL_HANDLE) {
+        LeaveCriticalSection(&cache->lock);
+        return VK_NULL_HANDLE;
+    }
+
+    RenderPassEntry* entry = malloc(sizeof(RenderPassEntry));
+    *entry = (RenderPassEntry) {
+        .next = cache->buckets[bucketIdx],
+        .key = key,
+        .renderPass = renderPass,
+    };
+
+    cache->buckets[bucketIdx] = entry;
+    cache->missCount++;
+
+    LeaveCriticalSection(&cache->lock);
+    return renderPass;
+}
+
+void getRenderPassCacheStats(
+    RenderPassCache* cache,
+    uint64_t* pHitCount,
+    uint64_t* pMissCount)
+{
+    EnterCriticalSection(&cache->lock);
+    *pHitCount = cache->hitCount;
+    *pMissCount = cache->missCount;
+    LeaveCriticalSection(&cache->lock);
+}
@@ -0,0 +1,203 @@
+#include "mantle_internal.h"
+
+#define STAGING_BUFFER_ALIGNMENT 16
+#define INVALID_MEMORY_TYPE_INDEX -1u
+
+typedef struct _StagingChunk {
+    struct _StagingChunk* next;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint8_t* data;
+    VkDeviceSize size;
+    VkDeviceSize offset;
+} StagingChunk;
+
+// Persistently mapped upload memory of a command buffer. Chunks are only allocated on first use
+// and kept across resets, the GPU is done with them once the command buffer gets recorded again.
+struct _StagingBuffer {
+    VkDevice device;
+    VkPhysicalDevice physicalDevice;
+    StagingChunk* firstChunk;
+    StagingChunk* currentChunk;
+    VkDeviceSize chunkSize;
+};
+
+static uint32_t getHostVisibleMemoryTypeIndex(
+    VkPhysicalDevice physicalDevice,
+    uint32_t memoryTypeBits)
+{
+    const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+
+    vki.vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    for (int i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((memoryTypeBits & (1 << i)) != 0 &&
+            (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+            return i;
+        }
+    }
+
+    return INVALID_MEMORY_TYPE_INDEX;
+}
+
+static StagingChunk* createStagingChunk(
+    StagingBuffer* stagingBuffer,
+    VkDeviceSize size)
+{
+    VkDevice vkDevice = stagingBuffer->device;
+    VkBuffer vkBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vkMemory = VK_NULL_HANDLE;
+    void* data = NULL;
+
+    const VkBufferCreateInfo bufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+    };
+
+    if (vki.vkCreateBuffer(vkDevice, &bufferCreateInfo, NULL, &vkBuffer) != VK_SUCCESS) {
+        printf("%s: vkCreateBuffer failed\n", __func__);
+        return NULL;
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vki.vkGetBufferMemoryRequirements(vkDevice, vkBuffer, &memoryRequirements);
+
+    uint32_t memoryTypeIndex = getHostVisibleMemoryTypeIndex(stagingBuffer->physicalDevice,
+                                                             memoryRequirements.memoryTypeBits);
+    if (memoryTypeIndex == INVALID_MEMORY_TYPE_INDEX) {
+        printf("%s: no host visible memory type found\n", __func__);
+        vki.vkDestroyBuffer(vkDevice, vkBuffer, NULL);
+        return NULL;
+    }
+
+    const VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = NULL,
+        .allocationSize = memoryRequirements.size,
+        .memoryTypeIndex = memoryTypeIndex,
+    };
+
+    if (vki.vkAllocateMemory(vkDevice, &allocateInfo, NULL, &vkMemory) != VK_SUCCESS) {
+        printf("%s: vkAllocateMemory failed\n", __func__);
+        vki.vkDestroyBuffer(vkDevice, vkBuffer, NULL);
+        return NULL;
+    }
+
+    if (vki.vkBindBufferMemory(vkDevice, vkBuffer, vkMemory, 0) != VK_SUCCESS ||
+        vki.vkMapMemory(vkDevice, vkMemory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+        printf("%s: failed to bind or map staging memory\n", __func__);
+        vki.vkDestroyBuffer(vkDevice, vkBuffer, NULL);
+        vki.vkFreeMemory(vkDevice, vkMemory, NULL);
+        return NULL;
+    }
+
+    StagingChunk* chunk = malloc(sizeof(StagingChunk));
+    *chunk = (StagingChunk) {
+        .next = NULL,
+        .buffer = vkBuffer,
+        .memory = vkMemory,
+        .data = data,
+        .size = size,
+        .offset = 0,
+    };
+
+    return chunk;
+}
+
+StagingBuffer* createStagingBuffer(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkDeviceSize chunkSize)
+{
+    StagingBuffer* stagingBuffer = malloc(sizeof(StagingBuffer));
+    *stagingBuffer = (StagingBuffer) {
+        .device = device,
+        .physicalDevice = physicalDevice,
+        .firstChunk = NULL,
+        .currentChunk = NULL,
+        .chunkSize = chunkSize,
+    };
+
+    return stagingBuffer;
+}
+
+void destroyStagingBuffer(
+    StagingBuffer* stagingBuffer)
+{
+    StagingChunk* chunk = stagingBuffer->firstChunk;
+
+    while (chunk != NULL) {
+        StagingChunk* next = chunk->next;
+
+        // Freeing the memory implicitly unmaps it
+        vki.vkDestroyBuffer(stagingBuffer->device, chunk->buffer, NULL);
+        vki.vkFreeMemory(stagingBuffer->device, chunk->memory, NULL);
+        free(chunk);
+        chunk = next;
+    }
+
+    free(stagingBuffer);
+}
+
+// Returns a pointer to write the data to, along with the buffer range to copy it from
+void* allocStagingBuffer(
+    StagingBuffer* stagingBuffer,
+    VkDeviceSize size,
+    VkBuffer* pBuffer,
+    VkDeviceSize* pOffset)
+{
+    size = (size + STAGING_BUFFER_ALIGNMENT - 1) & ~(VkDeviceSize)(STAGING_BUFFER_ALIGNMENT - 1);
+
+    if (stagingBuffer->firstChunk == NULL) {
+        stagingBuffer->firstChunk =
+            createStagingChunk(stagingBuffer, MAX(stagingBuffer->chunkSize, size));
+        if (stagingBuffer->firstChunk == NULL) {
+            return NULL;
+        }
+
+        stagingBuffer->currentChunk = stagingBuffer->firstChunk;
+    }
+
+    StagingChunk* chunk = stagingBuffer->currentChunk;
+    while (chunk->offset + size > chunk->size) {
+        if (chunk->next == NULL || chunk->next->size < size) {
+            // Insert a chunk large enough for this allocation
+            StagingChunk* newChunk =
+                createStagingChunk(stagingBuffer, MAX(stagingBuffer->chunkSize, size));
+            if (newChunk == NULL) {
+                return NULL;
+            }
+
+            newChunk->next = chunk->next;
+            chunk->next = newChunk;
+        }
+
+        chunk = chunk->next;
+        chunk->offset = 0;
+    }
+
+    void* ptr = &chunk->data[chunk->offset];
+    *pBuffer = chunk->buffer;
+    *pOffset = chunk->offset;
+    chunk->offset += size;
+    stagingBuffer->currentChunk = chunk;
+
+    return ptr;
+}
+
+void resetStagingBuffer(
+    StagingBuffer* stagingBuffer)
+{
+    if (stagingBuffer->firstChunk != NULL) {
+        stagingBuffer->currentChunk = stagingBuffer->firstChunk;
+        stagingBuffer->currentChunk->offset = 0;
+    }
+}
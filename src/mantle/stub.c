@@ -16,13 +16,6 @@ GR_RESULT grGetGpuInfo(
     return GR_UNSUPPORTED;
 }
 
-GR_RESULT grDestroyDevice(
-    GR_DEVICE device)
-{
-    printf("STUB: %s\n", __func__);
-    return GR_UNSUPPORTED;
-}
-
 // Extension Discovery Functions
 
 GR_RESULT grGetExtensionSupport(
@@ -103,15 +96,6 @@ GR_RESULT grPinSystemMemory(
     return GR_UNSUPPORTED;
 }
 
-// Generic API Object Management functions
-
-GR_RESULT grDestroyObject(
-    GR_OBJECT object)
-{
-    printf("STUB: %s\n", __func__);
-    return GR_UNSUPPORTED;
-}
-
 // Image and Sample Functions
 
 GR_RESULT grGetFormatInfo(
@@ -165,26 +149,8 @@ GR_RESULT grCreateImageView(
     return GR_UNSUPPORTED;
 }
 
-GR_RESULT grCreateDepthStencilView(
-    GR_DEVICE device,
-    const GR_DEPTH_STENCIL_VIEW_CREATE_INFO* pCreateInfo,
-    GR_DEPTH_STENCIL_VIEW* pView)
-{
-    printf("STUB: %s\n", __func__);
-    return GR_UNSUPPORTED;
-}
-
 // Shader and Pipeline Functions
 
-GR_RESULT grCreateComputePipeline(
-    GR_DEVICE device,
-    const GR_COMPUTE_PIPELINE_CREATE_INFO* pCreateInfo,
-    GR_PIPELINE* pPipeline)
-{
-    printf("STUB: %s\n", __func__);
-    return GR_UNSUPPORTED;
-}
-
 GR_RESULT grStorePipeline(
     GR_PIPELINE pipeline,
     GR_SIZE* pDataSize,
@@ -336,158 +302,8 @@ GR_RESULT grOpenPeerImage(
     return GR_UNSUPPORTED;
 }
 
-// Command Buffer Management Functions
-
-GR_RESULT grResetCommandBuffer(
-    GR_CMD_BUFFER cmdBuffer)
-{
-    printf("STUB: %s\n", __func__);
-    return GR_UNSUPPORTED;
-}
-
 // Command Buffer Building Functions
 
-GR_VOID grCmdBindDynamicMemoryView(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_ENUM pipelineBindPoint,
-    const GR_MEMORY_VIEW_ATTACH_INFO* pMemView)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdBindIndexData(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY mem,
-    GR_GPU_SIZE offset,
-    GR_ENUM indexType)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdDrawIndirect(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY mem,
-    GR_GPU_SIZE offset)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdDrawIndexedIndirect(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY mem,
-    GR_GPU_SIZE offset)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdDispatch(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_UINT x,
-    GR_UINT y,
-    GR_UINT z)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdDispatchIndirect(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY mem,
-    GR_GPU_SIZE offset)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdCopyMemory(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY srcMem,
-    GR_GPU_MEMORY destMem,
-    GR_UINT regionCount,
-    const GR_MEMORY_COPY* pRegions)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdCopyImage(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_IMAGE srcImage,
-    GR_IMAGE destImage,
-    GR_UINT regionCount,
-    const GR_IMAGE_COPY* pRegions)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdCopyMemoryToImage(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY srcMem,
-    GR_IMAGE destImage,
-    GR_UINT regionCount,
-    const GR_MEMORY_IMAGE_COPY* pRegions)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdCopyImageToMemory(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_IMAGE srcImage,
-    GR_GPU_MEMORY destMem,
-    GR_UINT regionCount,
-    const GR_MEMORY_IMAGE_COPY* pRegions)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdResolveImage(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_IMAGE srcImage,
-    GR_IMAGE destImage,
-    GR_UINT regionCount,
-    const GR_IMAGE_RESOLVE* pRegions)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdCloneImageData(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_IMAGE srcImage,
-    GR_ENUM srcImageState,
-    GR_IMAGE destImage,
-    GR_ENUM destImageState)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdUpdateMemory(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY destMem,
-    GR_GPU_SIZE destOffset,
-    GR_GPU_SIZE dataSize,
-    const GR_UINT32* pData)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdFillMemory(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_GPU_MEMORY destMem,
-    GR_GPU_SIZE destOffset,
-    GR_GPU_SIZE fillSize,
-    GR_UINT32 data)
-{
-    printf("STUB: %s\n", __func__);
-}
-
-GR_VOID grCmdClearDepthStencil(
-    GR_CMD_BUFFER cmdBuffer,
-    GR_IMAGE image,
-    GR_FLOAT depth,
-    GR_UINT8 stencil,
-    GR_UINT rangeCount,
-    const GR_IMAGE_SUBRESOURCE_RANGE* pRanges)
-{
-    printf("STUB: %s\n", __func__);
-}
-
 GR_VOID grCmdSetEvent(
     GR_CMD_BUFFER cmdBuffer,
     GR_EVENT event)
@@ -622,15 +438,6 @@ GR_RESULT grDbgSetObjectTag(
     return GR_UNSUPPORTED;
 }
 
-GR_RESULT grDbgSetGlobalOption(
-    GR_DBG_GLOBAL_OPTION dbgOption,
-    GR_SIZE dataSize,
-    const GR_VOID* pData)
-{
-    printf("STUB: %s\n", __func__);
-    return GR_UNSUPPORTED;
-}
-
 GR_RESULT grDbgSetDeviceOption(
     GR_DEVICE device,
     GR_DBG_DEVICE_OPTION dbgOption,
@@ -6,6 +6,18 @@
 #define PACK_FORMAT(channel, numeric) \
     ((channel) << 16 | (numeric))
 
+#define GRAPHICS_SHADER_STAGES \
+    (VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | \
+     VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT | \
+     VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT | \
+     VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT | \
+     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+
+#define TARGET_STAGES \
+    (VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | \
+     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | \
+     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT)
+
 GR_VOID* grvkAlloc(
     GR_SIZE size,
     GR_SIZE alignment,
@@ -189,13 +201,29 @@ VkImageLayout getVkImageLayout(
 {
     switch (imageState) {
     case GR_IMAGE_STATE_UNINITIALIZED:
+    case GR_IMAGE_STATE_DISCARD:
         return VK_IMAGE_LAYOUT_UNDEFINED;
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_READ_ONLY:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_READ_ONLY:
+    case GR_IMAGE_STATE_MULTI_SHADER_READ_ONLY:
+        return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    case GR_IMAGE_STATE_DATA_TRANSFER:
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_WRITE_ONLY:
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_READ_WRITE:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_WRITE_ONLY:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_READ_WRITE:
+    case GR_IMAGE_STATE_TARGET_AND_SHADER_READ_ONLY:
+    case GR_IMAGE_STATE_TARGET_SHADER_ACCESS_OPTIMAL:
+        return VK_IMAGE_LAYOUT_GENERAL;
     case GR_IMAGE_STATE_TARGET_RENDER_ACCESS_OPTIMAL:
         return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    case GR_IMAGE_STATE_RESOLVE_SOURCE:
+    case GR_IMAGE_STATE_DATA_TRANSFER_SOURCE:
+        return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
     case GR_IMAGE_STATE_CLEAR:
+    case GR_IMAGE_STATE_RESOLVE_DESTINATION:
+    case GR_IMAGE_STATE_DATA_TRANSFER_DESTINATION:
         return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    default:
-        break;
     }
 
     switch ((GR_WSI_WIN_IMAGE_STATE)imageState) {
@@ -213,14 +241,45 @@ VkAccessFlags getVkAccessFlagsImage(
 {
     switch (imageState) {
     case GR_IMAGE_STATE_UNINITIALIZED:
+    case GR_IMAGE_STATE_DISCARD:
         return 0;
+    case GR_IMAGE_STATE_DATA_TRANSFER:
+        return VK_ACCESS_TRANSFER_READ_BIT |
+               VK_ACCESS_TRANSFER_WRITE_BIT;
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_READ_ONLY:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_READ_ONLY:
+    case GR_IMAGE_STATE_MULTI_SHADER_READ_ONLY:
+        return VK_ACCESS_SHADER_READ_BIT;
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_WRITE_ONLY:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_WRITE_ONLY:
+        return VK_ACCESS_SHADER_WRITE_BIT;
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_READ_WRITE:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_READ_WRITE:
+        return VK_ACCESS_SHADER_READ_BIT |
+               VK_ACCESS_SHADER_WRITE_BIT;
+    case GR_IMAGE_STATE_TARGET_AND_SHADER_READ_ONLY:
+        return VK_ACCESS_SHADER_READ_BIT |
+               VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
     case GR_IMAGE_STATE_TARGET_RENDER_ACCESS_OPTIMAL:
-        return VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+               VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    case GR_IMAGE_STATE_TARGET_SHADER_ACCESS_OPTIMAL:
+        return VK_ACCESS_SHADER_READ_BIT |
+               VK_ACCESS_SHADER_WRITE_BIT |
+               VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+               VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    case GR_IMAGE_STATE_RESOLVE_SOURCE:
+    case GR_IMAGE_STATE_DATA_TRANSFER_SOURCE:
+        return VK_ACCESS_TRANSFER_READ_BIT;
     case GR_IMAGE_STATE_CLEAR:
+    case GR_IMAGE_STATE_RESOLVE_DESTINATION:
+    case GR_IMAGE_STATE_DATA_TRANSFER_DESTINATION:
         return VK_ACCESS_TRANSFER_WRITE_BIT;
-    default:
-        break;
     }
 
     switch ((GR_WSI_WIN_IMAGE_STATE)imageState) {
@@ -237,6 +296,8 @@ VkAccessFlags getVkAccessFlagsMemory(
     GR_MEMORY_STATE memoryState)
 {
     switch (memoryState) {
+    case GR_MEMORY_STATE_DISCARD:
+        return 0;
     case GR_MEMORY_STATE_DATA_TRANSFER:
         return VK_ACCESS_TRANSFER_READ_BIT |
                VK_ACCESS_TRANSFER_WRITE_BIT |
@@ -252,14 +313,114 @@ VkAccessFlags getVkAccessFlagsMemory(
     case GR_MEMORY_STATE_COMPUTE_SHADER_READ_WRITE:
         return VK_ACCESS_SHADER_READ_BIT |
                VK_ACCESS_SHADER_WRITE_BIT;
-    default:
-        break;
+    case GR_MEMORY_STATE_MULTI_USE_READ_ONLY:
+        return VK_ACCESS_SHADER_READ_BIT |
+               VK_ACCESS_INDEX_READ_BIT |
+               VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+               VK_ACCESS_TRANSFER_READ_BIT;
+    case GR_MEMORY_STATE_INDEX_DATA:
+        return VK_ACCESS_INDEX_READ_BIT;
+    case GR_MEMORY_STATE_INDIRECT_ARG:
+        return VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    case GR_MEMORY_STATE_WRITE_TIMESTAMP:
+    case GR_MEMORY_STATE_DATA_TRANSFER_DESTINATION:
+        return VK_ACCESS_TRANSFER_WRITE_BIT;
+    case GR_MEMORY_STATE_QUEUE_ATOMIC:
+        return VK_ACCESS_MEMORY_READ_BIT |
+               VK_ACCESS_MEMORY_WRITE_BIT; // TODO narrow down once queue atomics are implemented
+    case GR_MEMORY_STATE_DATA_TRANSFER_SOURCE:
+        return VK_ACCESS_TRANSFER_READ_BIT;
     }
 
     printf("%s: unsupported memory state 0x%x\n", __func__, memoryState);
     return 0;
 }
 
+VkPipelineStageFlags getVkPipelineStageFlagsImage(
+    GR_IMAGE_STATE imageState)
+{
+    switch (imageState) {
+    case GR_IMAGE_STATE_UNINITIALIZED:
+    case GR_IMAGE_STATE_DISCARD:
+        return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    case GR_IMAGE_STATE_DATA_TRANSFER:
+    case GR_IMAGE_STATE_CLEAR:
+    case GR_IMAGE_STATE_RESOLVE_SOURCE:
+    case GR_IMAGE_STATE_RESOLVE_DESTINATION:
+    case GR_IMAGE_STATE_DATA_TRANSFER_SOURCE:
+    case GR_IMAGE_STATE_DATA_TRANSFER_DESTINATION:
+        return VK_PIPELINE_STAGE_TRANSFER_BIT;
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_READ_ONLY:
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_WRITE_ONLY:
+    case GR_IMAGE_STATE_GRAPHICS_SHADER_READ_WRITE:
+        return GRAPHICS_SHADER_STAGES;
+    case GR_IMAGE_STATE_COMPUTE_SHADER_READ_ONLY:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_WRITE_ONLY:
+    case GR_IMAGE_STATE_COMPUTE_SHADER_READ_WRITE:
+        return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    case GR_IMAGE_STATE_MULTI_SHADER_READ_ONLY:
+        return GRAPHICS_SHADER_STAGES |
+               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    case GR_IMAGE_STATE_TARGET_AND_SHADER_READ_ONLY:
+        return TARGET_STAGES |
+               GRAPHICS_SHADER_STAGES |
+               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    case GR_IMAGE_STATE_TARGET_RENDER_ACCESS_OPTIMAL:
+        return TARGET_STAGES;
+    case GR_IMAGE_STATE_TARGET_SHADER_ACCESS_OPTIMAL:
+        return TARGET_STAGES |
+               GRAPHICS_SHADER_STAGES;
+    }
+
+    switch ((GR_WSI_WIN_IMAGE_STATE)imageState) {
+    case GR_WSI_WIN_IMAGE_STATE_PRESENT_WINDOWED:
+    case GR_WSI_WIN_IMAGE_STATE_PRESENT_FULLSCREEN:
+        return VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+
+    printf("%s: unsupported image state 0x%x\n", __func__, imageState);
+    return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
+VkPipelineStageFlags getVkPipelineStageFlagsMemory(
+    GR_MEMORY_STATE memoryState)
+{
+    switch (memoryState) {
+    case GR_MEMORY_STATE_DISCARD:
+        return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    case GR_MEMORY_STATE_DATA_TRANSFER:
+        return VK_PIPELINE_STAGE_TRANSFER_BIT |
+               VK_PIPELINE_STAGE_HOST_BIT;
+    case GR_MEMORY_STATE_GRAPHICS_SHADER_READ_ONLY:
+    case GR_MEMORY_STATE_GRAPHICS_SHADER_WRITE_ONLY:
+    case GR_MEMORY_STATE_GRAPHICS_SHADER_READ_WRITE:
+        return GRAPHICS_SHADER_STAGES;
+    case GR_MEMORY_STATE_COMPUTE_SHADER_READ_ONLY:
+    case GR_MEMORY_STATE_COMPUTE_SHADER_WRITE_ONLY:
+    case GR_MEMORY_STATE_COMPUTE_SHADER_READ_WRITE:
+        return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    case GR_MEMORY_STATE_MULTI_USE_READ_ONLY:
+        return GRAPHICS_SHADER_STAGES |
+               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+               VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+               VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+               VK_PIPELINE_STAGE_TRANSFER_BIT;
+    case GR_MEMORY_STATE_INDEX_DATA:
+        return VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    case GR_MEMORY_STATE_INDIRECT_ARG:
+        return VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    case GR_MEMORY_STATE_WRITE_TIMESTAMP:
+    case GR_MEMORY_STATE_DATA_TRANSFER_SOURCE:
+    case GR_MEMORY_STATE_DATA_TRANSFER_DESTINATION:
+        return VK_PIPELINE_STAGE_TRANSFER_BIT;
+    case GR_MEMORY_STATE_QUEUE_ATOMIC:
+        return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // TODO narrow down once queue atomics are implemented
+    }
+
+    printf("%s: unsupported memory state 0x%x\n", __func__, memoryState);
+    return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
 VkImageAspectFlags getVkImageAspectFlags(
     GR_IMAGE_ASPECT imageAspect)
 {
@@ -276,6 +437,44 @@ VkImageAspectFlags getVkImageAspectFlags(
     return 0;
 }
 
+VkImageAspectFlags getVkDepthStencilAspectFlags(
+    VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        break;
+    }
+
+    printf("%s: unsupported depth-stencil format %d\n", __func__, format);
+    return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+// Returns all aspects of a color or depth-stencil format
+VkImageAspectFlags getVkFormatAspectFlags(
+    VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_S8_UINT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return getVkDepthStencilAspectFlags(format);
+    default:
+        break;
+    }
+
+    return VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
 VkSampleCountFlagBits getVkSampleCountFlagBits(
     GR_UINT samples)
 {
@@ -582,6 +781,8 @@ VkShaderStageFlags getVkShaderStageFlags(
         return VK_SHADER_STAGE_GEOMETRY_BIT;
     case 4:
         return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
     }
 
     printf("%s: unsupported stage index %d\n", __func__, stageIndex);
@@ -601,3 +802,32 @@ VkPipelineBindPoint getVkPipelineBindPoint(
     printf("%s: unsupported pipeline bind point 0x%x\n", __func__, bindPoint);
     return GR_PIPELINE_BIND_POINT_GRAPHICS;
 }
+
+VkIndexType getVkIndexType(
+    GR_INDEX_TYPE indexType)
+{
+    switch (indexType) {
+    case GR_INDEX_16:
+        return VK_INDEX_TYPE_UINT16;
+    case GR_INDEX_32:
+        return VK_INDEX_TYPE_UINT32;
+    }
+
+    printf("%s: unsupported index type 0x%x\n", __func__, indexType);
+    return VK_INDEX_TYPE_UINT16;
+}
+
+uint32_t getVkQueueFamilyIndex(
+    GrDevice* grDevice,
+    GR_QUEUE_TYPE queueType)
+{
+    switch (queueType) {
+    case GR_QUEUE_UNIVERSAL:
+        return grDevice->universalQueueIndex;
+    case GR_QUEUE_COMPUTE:
+        return grDevice->computeQueueIndex;
+    }
+
+    printf("%s: invalid queue type %d\n", __func__, queueType);
+    return INVALID_QUEUE_INDEX;
+}
@@ -153,6 +153,7 @@ void vulkanLoaderInstanceInit(VkInstance instance)
     LOAD_VULKAN_FN(vki, instance, vkGetPipelineCacheData);
     LOAD_VULKAN_FN(vki, instance, vkGetQueryPoolResults);
     LOAD_VULKAN_FN(vki, instance, vkGetRenderAreaGranularity);
+    LOAD_VULKAN_FN(vki, instance, vkGetSemaphoreCounterValue);
     LOAD_VULKAN_FN(vki, instance, vkInvalidateMappedMemoryRanges);
     LOAD_VULKAN_FN(vki, instance, vkMapMemory);
     LOAD_VULKAN_FN(vki, instance, vkMergePipelineCaches);
@@ -185,6 +186,10 @@ void vulkanLoaderInstanceInit(VkInstance instance)
     LOAD_VULKAN_FN(vki, instance, vkCmdSetViewportWithCountEXT);
 #endif
 
+#ifdef VK_KHR_push_descriptor
+    LOAD_VULKAN_FN(vki, instance, vkCmdPushDescriptorSetKHR);
+#endif
+
 #ifdef VK_KHR_surface
     LOAD_VULKAN_FN(vki, instance, vkDestroySurfaceKHR);
     LOAD_VULKAN_FN(vki, instance, vkGetPhysicalDeviceSurfaceSupportKHR);
@@ -147,6 +147,7 @@ typedef struct _VULKAN_INSTANCE {
     VULKAN_FN(vkGetPipelineCacheData);
     VULKAN_FN(vkGetQueryPoolResults);
     VULKAN_FN(vkGetRenderAreaGranularity);
+    VULKAN_FN(vkGetSemaphoreCounterValue);
     VULKAN_FN(vkInvalidateMappedMemoryRanges);
     VULKAN_FN(vkMapMemory);
     VULKAN_FN(vkMergePipelineCaches);
@@ -179,6 +180,10 @@ typedef struct _VULKAN_INSTANCE {
     VULKAN_FN(vkCmdSetViewportWithCountEXT);
 #endif
 
+#ifdef VK_KHR_push_descriptor
+    VULKAN_FN(vkCmdPushDescriptorSetKHR);
+#endif
+
 #ifdef VK_KHR_surface
     VULKAN_FN(vkDestroySurfaceKHR);
     VULKAN_FN(vkGetPhysicalDeviceSurfaceSupportKHR);